@@ -163,20 +163,39 @@ ContactMechGui::ContactMechGui(int subject, WhichExp whichExp, WhichDof whichDOF
         ImGui::End();     
     }
 
-    void ContactMechGui::moveConstVel(double elapsed, TestLockDof isTest, WhichSpeed whichSpeed, double start, double stop){ // start and stop can be force or position
+    void ContactMechGui::moveConstVel(TestLockDof isTest, WhichSpeed whichSpeed, double start, double stop, bool stopIsPosition){ // start and stop can be force or position
         bool isIncreasing = start < stop;
         double sign = isIncreasing ? 1 : -1;
 
         double vel = (whichSpeed == Experiment) ? m_params.stimulus_velocity : m_params.travel_velocity;
 
-        if (isTest == Test){
-            m_targetPosTest += sign*vel*elapsed;
-            ContactMechGui::setTest(m_targetPosTest);
-            //std::cout << "m_targetPosTest " << m_targetPosTest << "current position" << getTestPos() << std::endl;
-        }else if (isTest == Lock) {
-            m_targetPosLock += sign*vel*elapsed;
-            ContactMechGui::setLock(m_targetPosLock);
-        }
+        std::shared_ptr<CM> cm = (isTest == Test) ? m_cm_test : m_cm_lock;
+        double& target = (isTest == Test) ? m_targetPosTest : m_targetPosLock;
+        // nothing in flight, so start from the target rather than wherever the last move ended
+        if (cm->trajectoryPending() == 0)
+            cm->queueSegment(Trajectory::Linear, target, 0);
+        // queue in halves of the lead so a chunk is always ready when the running one ends
+        while (cm->trajectoryPending() < 2) {
+            if (stopIsPosition && target == stop)
+                break;
+            target += sign*vel*MoveLead/2;
+            if (stopIsPosition)
+                target = isIncreasing ? std::min(target, stop) : std::max(target, stop);
+            if (cm->queueSegment(Trajectory::ConstantVelocity, target, vel) == 0)
+                break;
+        }
+        cm->limits_exceeded();
+        userLimitsExceeded();
+    }
+
+    void ContactMechGui::stopMove(TestLockDof isTest){
+        std::shared_ptr<CM> cm = (isTest == Test) ? m_cm_test : m_cm_lock;
+        cm->clearTrajectory();
+    }
+
+    bool ContactMechGui::moving(TestLockDof isTest){
+        std::shared_ptr<CM> cm = (isTest == Test) ? m_cm_test : m_cm_lock;
+        return cm->trajectoryPending() > 0;
     }
 
     void ContactMechGui::updateQuery(){
@@ -260,7 +279,7 @@ ContactMechGui::ContactMechGui(int subject, WhichExp whichExp, WhichDof whichDOF
                 std::cout << "     move normal direction to 85% of the range for testing  (t)" << std::endl;
                 m_targetPosLock = m_cm_lock->getSpoolPosition();
                 while (m_cm_lock->getSpoolPosition() < m_userShearTestNormPos) {
-                    moveConstVel(delta_time().as_seconds(), Lock, Calibration, m_cm_lock->getSpoolPosition(), m_userShearTestNormPos);
+                    moveConstVel(Lock, Calibration, m_cm_lock->getSpoolPosition(), m_userShearTestNormPos);
                     co_yield nullptr;
                 }
                 setLock(m_userShearTestNormPos);
@@ -270,9 +289,10 @@ ContactMechGui::ContactMechGui(int subject, WhichExp whichExp, WhichDof whichDOF
             m_targetPosTest = getTestPos();
             while (getTestForce() < m_params.initial_force) { // normal force less than 1G
                 std::cout << "      intitial: move down to " << m_params.initial_force << " N, currently at " << getTestForce() << " N" << std::endl;
-                moveConstVel(delta_time().as_seconds(), Test, Experiment, getTestForce(), m_params.initial_force); 
+                moveConstVel(Test, Experiment, getTestForce(), m_params.initial_force, false); 
                 co_yield nullptr;
             } 
+            stopMove(Test);
             m_poi = Min;
             writeOutputData(csv);
             m_poi = Other;
@@ -283,9 +303,10 @@ ContactMechGui::ContactMechGui(int subject, WhichExp whichExp, WhichDof whichDOF
             std::cout << "      from min to final, stop at " <<  finalForce << " N, currently " << getTestForce() << " N" << std::endl;
             while (getTestForce() < finalForce) { // normal force less than 1G
                 std::cout << "      max: move down to " << finalForce << " N, currently at " << getTestForce() << " N" << std::endl;
-                moveConstVel(delta_time().as_seconds(), Test, Experiment, getTestForce(), finalForce);
+                moveConstVel(Test, Experiment, getTestForce(), finalForce, false);
                 co_yield nullptr;
             }
+            stopMove(Test);
             std::cout << "      finished moving " << m_cyclenum << std::endl;
             m_poi = (m_whichExp == Ind) ? Peak : HoldInitial;
             writeOutputData(csv);
@@ -318,9 +339,10 @@ ContactMechGui::ContactMechGui(int subject, WhichExp whichExp, WhichDof whichDOF
             m_targetPosTest = getTestPos();
             while (getTestForce() > m_params.initial_force) { // normal force less than 1G
                 std::cout << "      min: move up to " << m_params.initial_force << " N, currently at" << getTestForce() << " N" << std::endl;
-                moveConstVel(delta_time().as_seconds(), Test, Experiment, getTestForce(), m_params.initial_force);
+                moveConstVel(Test, Experiment, getTestForce(), m_params.initial_force, false);
                 co_yield nullptr;
             }
+            stopMove(Test);
             m_poi = Min;
             writeOutputData(csv);
             m_poi = Other;
@@ -332,27 +354,33 @@ ContactMechGui::ContactMechGui(int subject, WhichExp whichExp, WhichDof whichDOF
                 m_targetPosTest = getTestPos();
                 while (m_targetPosTest > m_params.start_height) {
                     std::cout << "      start: move up to " << m_params.start_height << " mm, currently at" << getTestPos() << " mm" << std::endl;
-                    moveConstVel(delta_time().as_seconds(), Test, Experiment, getTestPos(), m_params.start_height);
+                    moveConstVel(Test, Experiment, getTestPos(), m_params.start_height);
                     co_yield nullptr;
                 }
+                while (moving(Test))
+                    co_yield nullptr;
             }else if(m_whichDof == Shear){
                 std::cout << "      from min to start, stop at 0.0 mm" << std::endl;
                 // decrease to starting point, at contact
                 m_targetPosTest = getTestPos();
                 while (m_targetPosTest > 0.0) {
                     std::cout << "      start: over to " << 0.0 << " mm, currently at " << getTestPos() << " mm" << std::endl;
-                    moveConstVel(delta_time().as_seconds(), Test, Experiment, getTestPos(), 0.0);
+                    moveConstVel(Test, Experiment, getTestPos(), 0.0);
                     co_yield nullptr;
                 }
+                while (moving(Test))
+                    co_yield nullptr;
 
                 std::cout << "      lift tactor to start position, stop at " <<  m_params.start_height << " mm" << std::endl;
                 // decrease to starting point, at contact
                 m_targetPosLock = getLockPos();
                 while (m_targetPosLock > m_params.start_height) {
                     std::cout << "      start: move up to " << m_params.start_height << " mm, currently at" << getLockPos() << " mm" << std::endl;
-                    moveConstVel(delta_time().as_seconds(), Lock, Experiment, getLockPos(), m_params.start_height);
+                    moveConstVel(Lock, Experiment, getLockPos(), m_params.start_height);
                     co_yield nullptr;
                 }
+                while (moving(Lock))
+                    co_yield nullptr;
             }
             m_poi = Start;
             writeOutputData(csv);
@@ -411,9 +439,11 @@ ContactMechGui::ContactMechGui(int subject, WhichExp whichExp, WhichDof whichDOF
                 // go to intiial cycle stimulus, at contact
                 m_targetPosTest = m_cm_test->getSpoolPosition();
                 while(m_targetPosTest < m_userStimulusPosMin) { // user absolute threshold
-                    moveConstVel(delta_time().as_seconds(), Test, Experiment, m_cm_test->getSpoolPosition(), m_userStimulusPosMin);
+                    moveConstVel(Test, Experiment, m_cm_test->getSpoolPosition(), m_userStimulusPosMin);
                     co_yield nullptr;
                 } 
+                while (moving(Test))
+                    co_yield nullptr;
                 m_poi = Min;
                 writeOutputData(csv);
                 m_poi = Other;
@@ -424,9 +454,11 @@ ContactMechGui::ContactMechGui(int subject, WhichExp whichExp, WhichDof whichDOF
             // increase stimulus to peak
             m_targetPosTest = m_cm_test->getSpoolPosition();
             while(m_targetPosTest < m_userStimulusPosMax) { // user maximum comfort threshold
-                moveConstVel(delta_time().as_seconds(), Test, Experiment, m_cm_test->getSpoolPosition(), m_userStimulusPosMax);
+                moveConstVel(Test, Experiment, m_cm_test->getSpoolPosition(), m_userStimulusPosMax);
                 co_yield nullptr;
             }
+            while (moving(Test))
+                co_yield nullptr;
             m_poi = Peak;
             writeOutputData(csv);
             m_poi = Other;
@@ -443,9 +475,11 @@ ContactMechGui::ContactMechGui(int subject, WhichExp whichExp, WhichDof whichDOF
             // decrease to intial cycle stimulus, at contact
             m_targetPosTest = m_cm_test->getSpoolPosition();
             while(m_targetPosTest > m_userStimulusPosMin) {
-                moveConstVel(delta_time().as_seconds(), Test, Experiment, m_cm_test->getSpoolPosition(), m_userStimulusPosMin);
+                moveConstVel(Test, Experiment, m_cm_test->getSpoolPosition(), m_userStimulusPosMin);
                 co_yield nullptr;
             }
+            while (moving(Test))
+                co_yield nullptr;
             m_poi = Min;
             writeOutputData(csv);
             m_poi = Other;
@@ -578,9 +612,10 @@ ContactMechGui::ContactMechGui(int subject, WhichExp whichExp, WhichDof whichDOF
             while (num_above_force < 20) {
                 if (m_cm_lock->getForce() > m_userparams.forceCont_n) num_above_force++;
                 else num_above_force = 0;
-                moveConstVel(delta_time().as_seconds(), Lock, Calibration, 0, 1); // start and stop set to 0 and 1 so always increasing, keep it from dancing
+                moveConstVel(Lock, Calibration, 0, 1, false); // start and stop set to 0 and 1 so always increasing, keep it from dancing
                 co_yield nullptr;
             }
+            stopMove(Lock);
 
             std::cout << "     force control to contact force" << std::endl;
             setForceControl(Lock);
@@ -597,9 +632,10 @@ ContactMechGui::ContactMechGui(int subject, WhichExp whichExp, WhichDof whichDOF
             while (num_above_force < 20) {
                 if (m_cm_test->getForce() > m_userparams.forceCont_n) num_above_force++;
                 else num_above_force = 0;
-                moveConstVel(delta_time().as_seconds(), Test, Calibration, 0, 1); // start and stop set to 0 and 1 so always increasing, keep it from dancing
+                moveConstVel(Test, Calibration, 0, 1, false); // start and stop set to 0 and 1 so always increasing, keep it from dancing
                 co_yield nullptr;
             }
+            stopMove(Test);
             std::cout << "     force control to contact force" << std::endl;
             setForceControl(Test);
             setTest( m_userparams.forceCont_n);
@@ -633,7 +669,7 @@ ContactMechGui::ContactMechGui(int subject, WhichExp whichExp, WhichDof whichDOF
             // move out of stimulus to starting position above the arm
             m_targetPosLock = m_cm_lock->getSpoolPosition();
             while (m_cm_lock->getSpoolPosition() > m_params.start_height) {
-                moveConstVel(delta_time().as_seconds(), Lock, Calibration, m_cm_lock->getSpoolPosition(), m_params.start_height);
+                moveConstVel(Lock, Calibration, m_cm_lock->getSpoolPosition(), m_params.start_height);
                 co_yield nullptr;
             }
             std::cout << "     set normal (lock) to start position" << std::endl;
@@ -647,7 +683,7 @@ ContactMechGui::ContactMechGui(int subject, WhichExp whichExp, WhichDof whichDOF
             std::cout << "start height: " << m_params.start_height << ", current height: " << m_cm_test->getSpoolPosition() << std::endl;
             m_targetPosTest = m_cm_test->getSpoolPosition();
             while (m_cm_test->getSpoolPosition() > m_params.start_height) {
-                moveConstVel(delta_time().as_seconds(), Test, Calibration, m_cm_test->getSpoolPosition(), m_params.start_height);
+                moveConstVel(Test, Calibration, m_cm_test->getSpoolPosition(), m_params.start_height);
                 co_yield nullptr;
             }
             std::cout << "     set normal (test) to start position" << std::endl;
@@ -669,7 +705,7 @@ ContactMechGui::ContactMechGui(int subject, WhichExp whichExp, WhichDof whichDOF
             std::cout << "     move normal direction to 85% of the range for testing  (t)" << std::endl;
             m_targetPosLock = m_cm_lock->getSpoolPosition();
             while (m_cm_lock->getSpoolPosition() < m_userShearTestNormPos) {
-                moveConstVel(delta_time().as_seconds(), Lock, Calibration, m_cm_lock->getSpoolPosition(), m_userShearTestNormPos);
+                moveConstVel(Lock, Calibration, m_cm_lock->getSpoolPosition(), m_userShearTestNormPos);
                 co_yield nullptr;
             }
             setLock(m_userShearTestNormPos);
@@ -678,7 +714,7 @@ ContactMechGui::ContactMechGui(int subject, WhichExp whichExp, WhichDof whichDOF
             std::cout << "     move the shear direction to zero for testing  (n)" << std::endl;
             m_targetPosLock = m_cm_lock->getSpoolPosition();
             while (m_cm_lock->getSpoolPosition() < m_userparams.positionCont_t) {
-                moveConstVel(delta_time().as_seconds(), Lock, Calibration, m_cm_lock->getSpoolPosition(), m_userparams.positionCont_t);
+                moveConstVel(Lock, Calibration, m_cm_lock->getSpoolPosition(), m_userparams.positionCont_t);
                 co_yield nullptr;
             }
         }
@@ -693,7 +729,7 @@ ContactMechGui::ContactMechGui(int subject, WhichExp whichExp, WhichDof whichDOF
             std::cout << "     move the shear direction to zero for testing  (n)" << std::endl;
             m_targetPosTest = m_cm_test->getSpoolPosition();
             while (m_cm_test->getSpoolPosition() > m_userparams.positionCont_t) {
-                moveConstVel(delta_time().as_seconds(), Test, Calibration, m_cm_test->getSpoolPosition(), m_userparams.positionCont_t);
+                moveConstVel(Test, Calibration, m_cm_test->getSpoolPosition(), m_userparams.positionCont_t);
                 co_yield nullptr;
             }
             setTest(m_userparams.positionCont_t);
@@ -702,7 +738,7 @@ ContactMechGui::ContactMechGui(int subject, WhichExp whichExp, WhichDof whichDOF
             std::cout << "     move norm to start height" << std::endl;
             m_targetPosTest = m_cm_test->getSpoolPosition();
             while (m_cm_test->getSpoolPosition() > m_params.start_height) {
-                moveConstVel(delta_time().as_seconds(), Test, Calibration, m_cm_test->getSpoolPosition(), m_params.start_height);
+                moveConstVel(Test, Calibration, m_cm_test->getSpoolPosition(), m_params.start_height);
                 co_yield nullptr;
             }
             setTest(m_params.start_height);
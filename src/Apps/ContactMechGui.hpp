@@ -121,7 +121,15 @@ public:
 
     void update() override;
 
-    void moveConstVel(double elapsed, TestLockDof isTest, WhichSpeed whichSpeed, double start, double stop);
+    // Keeps a short lead of constant velocity segments queued on the hub, so motion is smooth at the control
+    // rate and stops within MoveLead of the coroutine no longer calling this. When stop is a position, queued
+    // targets are clamped to it and nothing more is queued once it is reached; force moves and
+    // direction-only ramps pass false and call stopMove as soon as their condition is met
+    void moveConstVel(TestLockDof isTest, WhichSpeed whichSpeed, double start, double stop, bool stopIsPosition = true);
+    // Drops the lead moveConstVel keeps queued, so the DOF holds where its setpoint is on the next tick
+    void stopMove(TestLockDof isTest);
+    // True until the lead moveConstVel queued has played out (yield on this before recording a position)
+    bool moving(TestLockDof isTest);
 
     void updateQuery();
     
@@ -236,6 +244,7 @@ private:
     double  m_userShearTestNormPos      = 0;
     double  m_targetPosLock             = 0;
     double  m_targetPosTest             = 0;
+    static constexpr double MoveLead    = 0.05;  // [s] motion queued ahead of the GUI
 
     // Hertzian Contact
     HertzianContact             m_hz;
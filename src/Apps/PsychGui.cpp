@@ -1,18 +1,20 @@
 #include "PsychGui.hpp"
+#include <limits>
 
 using namespace mahi::gui;
 using namespace mahi::util;
 using namespace mahi::robo;
 using namespace xbox;
 
-PsychGui::PsychGui(int subject, PsychTest::WhichExp whichExp, PsychTest::WhichDof whichDOF, PsychTest::ControlType controller) : 
+PsychGui::PsychGui(int subject, PsychTest::WhichExp whichExp, PsychTest::WhichDof whichDOF, PsychTest::ControlType controller, bool simulated) : 
     Application(600,1000,"Capstan Module Psychophysical Test (Subject " + std::to_string(subject) + ")" ,false), 
     m_pt(subject, PsychTest::Params(), whichExp, whichDOF, controller), // Hardware specific
     ts(),
     filename_timeseries("C:/Git/TactilePsychophysics/data/" + m_pt.expchoice[m_pt.m_whichExp] + "/_subject_" + std::to_string(m_pt.m_subject) + "_timeseries_" + m_pt.dofChoice[m_pt.m_whichDof] + "_" + m_pt.controlChoice[m_pt.m_controller] + "_" + m_pt.expchoice[m_pt.m_whichExp] + "_" + ts.yyyy_mm_dd_hh_mm_ss() + ".csv"),
     csv_timeseries(filename_timeseries),
     filename("C:/Git/TactilePsychophysics/data/" + m_pt.expchoice[m_pt.m_whichExp] + "/_subject_" + std::to_string(m_pt.m_subject) + "_trialdata_" + m_pt.dofChoice[m_pt.m_whichDof] + "_" + m_pt.controlChoice[m_pt.m_controller] + "_" + m_pt.expchoice[m_pt.m_whichExp] + "_" + ts.yyyy_mm_dd_hh_mm_ss() + ".csv"),
-    csv(filename)
+    csv(filename),
+    m_hub(1000, simulated)
     {          
         connectToIO();
         importUserHardwareParams();
@@ -228,14 +230,24 @@ PsychGui::PsychGui(int subject, PsychTest::WhichExp whichExp, PsychTest::WhichDo
     }
 
 
-    void PsychGui::rampStimulus(double start, double end, double ramptime, double elapsed){
-        double stimVal = Tween::Linear(start, end, (float)(elapsed / ramptime));
-        PsychGui::setTest(stimVal);
+    void PsychGui::rampStimulus(double start, double end, double ramptime){
+        m_cm_test->queueSegment(Trajectory::Linear, start, 0);
+        m_rampTest = m_cm_test->queueSegment(Trajectory::Linear, end, ramptime);
     }
 
-    void PsychGui::rampLock(double start, double end, double ramptime, double elapsed){
-        double stimVal = Tween::Linear(start, end, (float)(elapsed / ramptime));
-        PsychGui::setLock(stimVal);
+    void PsychGui::rampLock(double start, double end, double ramptime){
+        m_cm_lock->queueSegment(Trajectory::Linear, start, 0);
+        m_rampLock = m_cm_lock->queueSegment(Trajectory::Linear, end, ramptime);
+    }
+
+    bool PsychGui::stimulusRamping(){
+        userLimitsExceeded();
+        return !m_cm_test->trajectoryDone(m_rampTest);
+    }
+
+    bool PsychGui::lockRamping(){
+        userLimitsExceeded();
+        return !m_cm_lock->trajectoryDone(m_rampLock);
     }
 
     //////////////////////////////////////////////////////////////////////////////////////
@@ -270,8 +282,8 @@ PsychGui::PsychGui(int subject, PsychTest::WhichExp whichExp, PsychTest::WhichDo
                 // render first stimulus - ramp up
                 std::cout << "ramp up to first stim" << std::endl;
                 elapsed = 0;
-                while (elapsed < m_psychparams.ramp_time) {
-                    rampStimulus(m_pt.m_userStimulusContact, m_pt.m_q_mcs.stimulus1, m_psychparams.ramp_time, elapsed);
+                rampStimulus(m_pt.m_userStimulusContact, m_pt.m_q_mcs.stimulus1, m_psychparams.ramp_time);
+                while (stimulusRamping()) {
                     responseWindow(PsychTest::First);
                     elapsed += delta_time().as_seconds();
                     if(int(elapsed*10) == 0){
@@ -297,8 +309,8 @@ PsychGui::PsychGui(int subject, PsychTest::WhichExp whichExp, PsychTest::WhichDo
                 // render first stimulus - ramp down
                 std::cout << "ramp down first stim to contact" << std::endl;
                 elapsed = 0;
-                while (elapsed < m_psychparams.ramp_time) {
-                    rampStimulus(m_pt.m_q_mcs.stimulus1, m_pt.m_userStimulusContact, m_psychparams.ramp_time, elapsed);
+                rampStimulus(m_pt.m_q_mcs.stimulus1, m_pt.m_userStimulusContact, m_psychparams.ramp_time);
+                while (stimulusRamping()) {
                     responseWindow(PsychTest::First);
                     elapsed += delta_time().as_seconds();
                     co_yield nullptr;
@@ -315,8 +327,8 @@ PsychGui::PsychGui(int subject, PsychTest::WhichExp whichExp, PsychTest::WhichDo
                 // render second stimulus - ramp up
                 std::cout << "ramp up to second stim" << std::endl;
                 elapsed = 0;
-                while (elapsed < m_psychparams.ramp_time) {
-                    rampStimulus(m_pt.m_userStimulusContact, m_pt.m_q_mcs.stimulus2, m_psychparams.ramp_time, elapsed);
+                rampStimulus(m_pt.m_userStimulusContact, m_pt.m_q_mcs.stimulus2, m_psychparams.ramp_time);
+                while (stimulusRamping()) {
                     responseWindow(PsychTest::Second);
                     elapsed += delta_time().as_seconds();
                     co_yield nullptr;
@@ -336,8 +348,8 @@ PsychGui::PsychGui(int subject, PsychTest::WhichExp whichExp, PsychTest::WhichDo
                 // render second stimulus - ramp down
                 std::cout << "ramp down second stim to contact" << std::endl;
                 elapsed = 0;
-                while (elapsed < m_psychparams.ramp_time) {
-                    rampStimulus(m_pt.m_q_mcs.stimulus2, m_pt.m_userStimulusContact, m_psychparams.ramp_time, elapsed);
+                rampStimulus(m_pt.m_q_mcs.stimulus2, m_pt.m_userStimulusContact, m_psychparams.ramp_time);
+                while (stimulusRamping()) {
                     responseWindow(PsychTest::Second);
                     elapsed += delta_time().as_seconds();
                     co_yield nullptr;
@@ -445,8 +457,8 @@ PsychGui::PsychGui(int subject, PsychTest::WhichExp whichExp, PsychTest::WhichDo
                         std::cout << "     move normal direction to 85% of the range for testing  (t)" << std::endl;
                         double elapsed = 0;
                         double travelT = 4*m_psychparams.travel_time;
-                        while ( travelT > elapsed) {
-                            rampLock(m_cm_lock->getSpoolPosition(), m_pt.m_userShearTestNormPos, travelT, elapsed); 
+                        rampLock(m_cm_lock->getSpoolPosition(), m_pt.m_userShearTestNormPos, travelT);
+                        while (lockRamping()) {
                             elapsed += delta_time().as_seconds();
                             co_yield nullptr;
                         }
@@ -462,8 +474,8 @@ PsychGui::PsychGui(int subject, PsychTest::WhichExp whichExp, PsychTest::WhichDo
                         // move normal dof to testing location
                         std::cout << "     move norm to contact point" << std::endl;
                         double elapsed = 0;
-                        while (m_psychparams.travel_time > elapsed) {
-                            rampStimulus(m_cm_test->getSpoolPosition(), m_pt.m_userparams.positionCont_n, m_psychparams.travel_time, elapsed); 
+                        rampStimulus(m_cm_test->getSpoolPosition(), m_pt.m_userparams.positionCont_n, m_psychparams.travel_time);
+                        while (stimulusRamping()) {
                             elapsed += delta_time().as_seconds();
                             co_yield nullptr;
                         }
@@ -484,8 +496,8 @@ PsychGui::PsychGui(int subject, PsychTest::WhichExp whichExp, PsychTest::WhichDo
                 while (m_pt.m_q_sm.num_reversal < m_psychparams.n_sm_reversals){
                     // render first stimulus - ramp up
                     elapsed = 0;
-                    while (elapsed < m_psychparams.ramp_time) {
-                        rampStimulus(m_pt.m_userStimulusContact, m_pt.m_q_sm.stimulus1, m_psychparams.ramp_time, elapsed);
+                    rampStimulus(m_pt.m_userStimulusContact, m_pt.m_q_sm.stimulus1, m_psychparams.ramp_time);
+                    while (stimulusRamping()) {
                         responseWindow(PsychTest::First);
                         elapsed += delta_time().as_seconds();
                         co_yield nullptr;
@@ -504,8 +516,8 @@ PsychGui::PsychGui(int subject, PsychTest::WhichExp whichExp, PsychTest::WhichDo
 
                     // render first stimulus - ramp down
                     elapsed = 0;
-                    while (elapsed < m_psychparams.ramp_time) {
-                        rampStimulus(m_pt.m_q_sm.stimulus1, m_pt.m_userStimulusContact, m_psychparams.ramp_time, elapsed);
+                    rampStimulus(m_pt.m_q_sm.stimulus1, m_pt.m_userStimulusContact, m_psychparams.ramp_time);
+                    while (stimulusRamping()) {
                         responseWindow(PsychTest::First);
                         elapsed += delta_time().as_seconds();
                         co_yield nullptr;
@@ -520,8 +532,8 @@ PsychGui::PsychGui(int subject, PsychTest::WhichExp whichExp, PsychTest::WhichDo
                     }
                     // render second stimulus - ramp up
                     elapsed = 0;
-                    while (elapsed < m_psychparams.ramp_time) {
-                        rampStimulus(m_pt.m_userStimulusContact, m_pt.m_q_sm.stimulus2, m_psychparams.ramp_time, elapsed);
+                    rampStimulus(m_pt.m_userStimulusContact, m_pt.m_q_sm.stimulus2, m_psychparams.ramp_time);
+                    while (stimulusRamping()) {
                         responseWindow(PsychTest::Second);
                         elapsed += delta_time().as_seconds();
                         co_yield nullptr;
@@ -539,8 +551,8 @@ PsychGui::PsychGui(int subject, PsychTest::WhichExp whichExp, PsychTest::WhichDo
 
                     // render second stimulus - ramp down
                     elapsed = 0;
-                    while (elapsed < m_psychparams.ramp_time) {
-                        rampStimulus(m_pt.m_q_sm.stimulus2, m_pt.m_userStimulusContact, m_psychparams.ramp_time, elapsed);
+                    rampStimulus(m_pt.m_q_sm.stimulus2, m_pt.m_userStimulusContact, m_psychparams.ramp_time);
+                    while (stimulusRamping()) {
                         responseWindow(PsychTest::Second);
                         elapsed += delta_time().as_seconds();
                         co_yield nullptr;
@@ -731,8 +743,8 @@ PsychGui::PsychGui(int subject, PsychTest::WhichExp whichExp, PsychTest::WhichDo
 
                 // render first stimulus - ramp up
                 elapsed = 0;
-                while (elapsed < m_psychparams.ramp_time) {
-                    rampStimulus(m_pt.m_userStimulusContact, m_pt.m_q_ma.stimulus1, m_psychparams.ramp_time, elapsed);
+                rampStimulus(m_pt.m_userStimulusContact, m_pt.m_q_ma.stimulus1, m_psychparams.ramp_time);
+                while (stimulusRamping()) {
                     responseWindowMA(PsychTest::First);
                     elapsed += delta_time().as_seconds();
                     co_yield nullptr;
@@ -750,8 +762,8 @@ PsychGui::PsychGui(int subject, PsychTest::WhichExp whichExp, PsychTest::WhichDo
 
                 // render first stimulus - ramp down
                 elapsed = 0;
-                while (elapsed < m_psychparams.ramp_time) {
-                    rampStimulus(m_pt.m_q_ma.stimulus1, m_pt.m_userStimulusContact, m_psychparams.ramp_time, elapsed);
+                rampStimulus(m_pt.m_q_ma.stimulus1, m_pt.m_userStimulusContact, m_psychparams.ramp_time);
+                while (stimulusRamping()) {
                     responseWindowMA(PsychTest::First);
                     elapsed += delta_time().as_seconds();
                     co_yield nullptr;
@@ -766,8 +778,8 @@ PsychGui::PsychGui(int subject, PsychTest::WhichExp whichExp, PsychTest::WhichDo
                 }
                 // render second stimulus - ramp up
                 elapsed = 0;
-                while (elapsed < m_psychparams.ramp_time) {
-                    rampStimulus(m_pt.m_userStimulusContact, m_pt.m_q_ma.stimulus2, m_psychparams.ramp_time, elapsed);
+                rampStimulus(m_pt.m_userStimulusContact, m_pt.m_q_ma.stimulus2, m_psychparams.ramp_time);
+                while (stimulusRamping()) {
                     responseWindowMA(PsychTest::Second);
                     elapsed += delta_time().as_seconds();
                     co_yield nullptr;
@@ -785,8 +797,8 @@ PsychGui::PsychGui(int subject, PsychTest::WhichExp whichExp, PsychTest::WhichDo
 
                 // render second stimulus - ramp down
                 elapsed = 0;
-                while (elapsed < m_psychparams.ramp_time) {
-                    rampStimulus(m_pt.m_q_ma.stimulus2, m_pt.m_userStimulusContact, m_psychparams.ramp_time, elapsed);
+                rampStimulus(m_pt.m_q_ma.stimulus2, m_pt.m_userStimulusContact, m_psychparams.ramp_time);
+                while (stimulusRamping()) {
                     responseWindowMA(PsychTest::Second);
                     elapsed += delta_time().as_seconds();
                     co_yield nullptr;
@@ -808,8 +820,8 @@ PsychGui::PsychGui(int subject, PsychTest::WhichExp whichExp, PsychTest::WhichDo
 
             // render comparison stimulus for adjustment - ramp up
             elapsed = 0;
-            while (elapsed < m_psychparams.ramp_time) {
-                rampStimulus(m_pt.m_userStimulusContact, m_pt.m_q_ma.stimulus2, m_psychparams.ramp_time, elapsed);
+            rampStimulus(m_pt.m_userStimulusContact, m_pt.m_q_ma.stimulus2, m_psychparams.ramp_time);
+            while (stimulusRamping()) {
                 responseWindowMA(PsychTest::Choose);
                 elapsed += delta_time().as_seconds();
                 co_yield nullptr;
@@ -840,8 +852,8 @@ PsychGui::PsychGui(int subject, PsychTest::WhichExp whichExp, PsychTest::WhichDo
 
             // return to contact position for next trial - ramp down
             elapsed = 0;
-            while (elapsed < m_psychparams.ramp_time) {
-                rampStimulus(m_jnd_current_stimulus, m_pt.m_userStimulusContact, m_psychparams.ramp_time, elapsed);
+            rampStimulus(m_jnd_current_stimulus, m_pt.m_userStimulusContact, m_psychparams.ramp_time);
+            while (stimulusRamping()) {
                 responseWindowMA(PsychTest::NA);
                 elapsed += delta_time().as_seconds();
                 co_yield nullptr;
@@ -951,6 +963,7 @@ PsychGui::PsychGui(int subject, PsychTest::WhichExp whichExp, PsychTest::WhichDo
             m_cm_test->setPositionRange(m_paramsTest.positionMin, m_pt.m_maxRangePercent*m_pt.m_userparams.positionMax_n); // [mm] subject-specific
             m_cm_test->setForceRange(m_paramsTest.forceMin, m_pt.m_maxRangePercent*m_pt.m_userparams.forceMax_n); // [N] subject-specific
         }
+        setUserLimits();
     }
 
     void PsychGui::stopExp(){
@@ -1045,8 +1058,8 @@ PsychGui::PsychGui(int subject, PsychTest::WhichExp whichExp, PsychTest::WhichDo
         if (m_pt.m_whichDof == PsychTest::Shear){
             // move shear to center
             double elapsed = 0;
-            while (elapsed < m_psychparams.travel_time) {
-                rampStimulus(m_cm_test->getSpoolPosition(), m_pt.m_userparams.positionStart_t, m_psychparams.travel_time, elapsed);
+            rampStimulus(m_cm_test->getSpoolPosition(), m_pt.m_userparams.positionStart_t, m_psychparams.travel_time);
+            while (stimulusRamping()) {
                 elapsed += delta_time().as_seconds();
                 co_yield nullptr;
             }
@@ -1055,9 +1068,9 @@ PsychGui::PsychGui(int subject, PsychTest::WhichExp whichExp, PsychTest::WhichDo
 
             // move out of stimulus to starting position above the arm
             elapsed = 0;
-            while (elapsed < m_psychparams.travel_time) {
+            rampLock(m_cm_lock->getSpoolPosition(), m_pt.m_userparams.positionStart_n, m_psychparams.travel_time);
+            while (lockRamping()) {
                 std::cout << "m_cm_lock->getSpoolPosition()" << m_cm_lock->getSpoolPosition() << " m_pt.m_userparams.positionStart_n " << m_pt.m_userparams.positionStart_n << std::endl;
-                rampLock(m_cm_lock->getSpoolPosition(), m_pt.m_userparams.positionStart_n, m_psychparams.travel_time, elapsed);
                 elapsed += delta_time().as_seconds();
                 co_yield nullptr;
             }
@@ -1067,8 +1080,8 @@ PsychGui::PsychGui(int subject, PsychTest::WhichExp whichExp, PsychTest::WhichDo
         }else if (m_pt.m_whichDof == PsychTest::Normal){
             // move shear to center
             double elapsed = 0;
-            while (elapsed < m_psychparams.travel_time) {
-                rampStimulus(m_cm_lock->getSpoolPosition(), m_pt.m_userparams.positionStart_t, m_psychparams.travel_time, elapsed);
+            rampStimulus(m_cm_lock->getSpoolPosition(), m_pt.m_userparams.positionStart_t, m_psychparams.travel_time);
+            while (stimulusRamping()) {
                 elapsed += delta_time().as_seconds();
                 co_yield nullptr;
             }
@@ -1077,8 +1090,8 @@ PsychGui::PsychGui(int subject, PsychTest::WhichExp whichExp, PsychTest::WhichDo
 
             // move out of stimulus to starting position above the arm
             elapsed = 0;
-            while (elapsed < m_psychparams.travel_time) {
-                rampStimulus(m_cm_test->getSpoolPosition(), m_pt.m_userparams.positionStart_n, m_psychparams.travel_time, elapsed);
+            rampStimulus(m_cm_test->getSpoolPosition(), m_pt.m_userparams.positionStart_n, m_psychparams.travel_time);
+            while (stimulusRamping()) {
                 elapsed += delta_time().as_seconds();
                 co_yield nullptr;
             }
@@ -1098,8 +1111,8 @@ PsychGui::PsychGui(int subject, PsychTest::WhichExp whichExp, PsychTest::WhichDo
             std::cout << "     move normal direction to 80% of the range for testing  (t)" << std::endl;
             double elapsed = 0;
             double travelT = 4*m_psychparams.travel_time;
-            while ( travelT > elapsed) {
-                rampLock(m_cm_lock->getSpoolPosition(), m_pt.m_userShearTestNormPos, travelT, elapsed); 
+            rampLock(m_cm_lock->getSpoolPosition(), m_pt.m_userShearTestNormPos, travelT);
+            while (lockRamping()) {
                 elapsed += delta_time().as_seconds();
                 co_yield nullptr;
             }
@@ -1108,8 +1121,8 @@ PsychGui::PsychGui(int subject, PsychTest::WhichExp whichExp, PsychTest::WhichDo
             // move shear dof to testing location
             std::cout << "     move the shear direction to zero for testing  (n)" << std::endl;
             double elapsed = 0;
-            while (m_psychparams.travel_time > elapsed) {
-                rampLock(m_cm_lock->getSpoolPosition(), 0, m_psychparams.travel_time, elapsed);
+            rampLock(m_cm_lock->getSpoolPosition(), 0, m_psychparams.travel_time);
+            while (lockRamping()) {
                 elapsed += delta_time().as_seconds();
                 co_yield nullptr;
             }
@@ -1131,8 +1144,8 @@ PsychGui::PsychGui(int subject, PsychTest::WhichExp whichExp, PsychTest::WhichDo
             // move normal dof to testing location
             std::cout << "     move norm to contact point" << std::endl;
             double elapsed = 0;
-            while (m_psychparams.travel_time > elapsed) {
-                rampStimulus(m_cm_test->getSpoolPosition(), m_pt.m_userparams.positionCont_n, m_psychparams.travel_time, elapsed); 
+            rampStimulus(m_cm_test->getSpoolPosition(), m_pt.m_userparams.positionCont_n, m_psychparams.travel_time);
+            while (stimulusRamping()) {
                 elapsed += delta_time().as_seconds();
                 co_yield nullptr;
             }
@@ -1209,13 +1222,11 @@ PsychGui::PsychGui(int subject, PsychTest::WhichExp whichExp, PsychTest::WhichDo
 
     void PsychGui::setTest(double N) {
         m_cm_test->setControlValue(m_cm_test->scaleRefToCtrlValue(N));
-        m_cm_test->limits_exceeded();
         userLimitsExceeded();
     }
 
     void PsychGui::setLock(double N) {
         m_cm_lock->setControlValue(m_cm_lock->scaleRefToCtrlValue(N));
-        m_cm_lock->limits_exceeded();
         userLimitsExceeded();
     }
 
@@ -1233,52 +1244,32 @@ PsychGui::PsychGui(int subject, PsychTest::WhichExp whichExp, PsychTest::WhichDo
         }
     }
 
-    void PsychGui::userLimitsExceeded(){
-        if (m_pt.m_whichDof == PsychTest::Shear){ // test shear
-            if(m_pt.m_controller == PsychTest::Force){
-                if(m_cm_test->getForce(1) > m_pt.m_userparams.forceMax_t){
-                    LOG(Warning) << "Exceeded User Shear Force Limit, " << m_pt.m_userparams.forceMax_t << " N with a value of " << m_cm_test->getForce(1) << " N.";
-                    stopExp();
-                } else if(m_cm_lock->getForce(1) > m_pt.m_userparams.forceMax_n){
-                    LOG(Warning) << "Exceeded User Normal Force Limit, " << m_pt.m_userparams.forceMax_n << " N with a value of " << m_cm_lock->getForce(1) << " N.";
-                    stopExp();
-                }
-            }
-
-            if(m_pt.m_controller == PsychTest::Position){
-                if(m_cm_test->getSpoolPosition() > m_pt.m_userparams.positionMax_t){
-                    LOG(Warning) << "Exceeded User Shear Position Limit, " << m_pt.m_userparams.positionMax_t << " mm with a value of " << m_cm_test->getSpoolPosition() << " mm.";
-                    stopExp();
-                }else if(m_cm_lock->getSpoolPosition() > m_pt.m_userparams.positionMax_n){
-                    LOG(Warning) << "Exceeded User Normal Position Limit, " << m_pt.m_userparams.positionMax_n << " mm with a value of " << m_cm_lock->getSpoolPosition() << " mm.";
-                    stopExp();
-                }
-            }
-    
-        }else if (m_pt.m_whichDof == PsychTest::Normal){ // test normal
-
-            if(m_pt.m_controller == PsychTest::Force){
-                if(m_cm_test->getForce(1) > m_pt.m_userparams.forceMax_n){
-                    LOG(Warning) << "Exceeded User Normal Force Limit, " << m_pt.m_userparams.forceMax_n << " N with a value of " << m_cm_test->getForce(1) << " N.";
-                    stopExp();
-                } else if(m_cm_lock->getForce(1) > m_pt.m_userparams.forceMax_t){
-                    LOG(Warning) << "Exceeded User Shear Force Limit, " << m_pt.m_userparams.forceMax_t << " N with a value of " << m_cm_lock->getForce(1) << " N.";
-                    stopExp();
-                }
-            }
+    void PsychGui::setUserLimits(){
+        // the hub supervisor checks these every control tick, so a violation disables within 1 ms
+        double forceMax_test = m_pt.m_whichDof == PsychTest::Shear ? m_pt.m_userparams.forceMax_t : m_pt.m_userparams.forceMax_n;
+        double forceMax_lock = m_pt.m_whichDof == PsychTest::Shear ? m_pt.m_userparams.forceMax_n : m_pt.m_userparams.forceMax_t;
+        double positionMax_test = m_pt.m_whichDof == PsychTest::Shear ? m_pt.m_userparams.positionMax_t : m_pt.m_userparams.positionMax_n;
+        double positionMax_lock = m_pt.m_whichDof == PsychTest::Shear ? m_pt.m_userparams.positionMax_n : m_pt.m_userparams.positionMax_t;
+        const double inf = std::numeric_limits<double>::infinity();
+        if(m_pt.m_controller == PsychTest::Force){
+            m_cm_test->setUserForceLimits(-inf, forceMax_test);
+            m_cm_lock->setUserForceLimits(-inf, forceMax_lock);
+        }
+        if(m_pt.m_controller == PsychTest::Position){
+            m_cm_test->setUserPositionLimits(-inf, positionMax_test);
+            m_cm_lock->setUserPositionLimits(-inf, positionMax_lock);
+        }
+    }
 
-            if(m_pt.m_controller == PsychTest::Position){
-                if(m_cm_test->getSpoolPosition() > m_pt.m_userparams.positionMax_n){
-                    LOG(Warning) << "Exceeded User Normal Position Limit, " << m_pt.m_userparams.positionMax_n << " mm with a value of " << m_cm_test->getSpoolPosition() << " mm.";
-                    stopExp();
-                } else if(m_cm_lock->getSpoolPosition() > m_pt.m_userparams.positionMax_t){
-                    LOG(Warning) << "Exceeded User Shear Position Limit, " << m_pt.m_userparams.positionMax_t << " mm with a value of " << m_cm_lock->getSpoolPosition() << " mm.";
-                    stopExp();
-                }
+    void PsychGui::userLimitsExceeded(){
+        for (auto& cm : {m_cm_test, m_cm_lock}) {
+            int cause = cm->getTripCause();
+            if (cause != CM::NoTrip){
+                LOG(Warning) << "CM " << cm->name() << " was disabled by the hub supervisor (" << CM::tripName(cause) << ").";
+                stopExp();
+                return;
             }
-    
         }
-
     }
 
     void PsychGui::collectSensorData(PsychTest::WhichStim whichStim, int refOrder){
@@ -44,9 +44,9 @@ public:
 
     // Method of Constant Stimuli - Psychophysical Study
     // Done in either force or position control
-    // Assumes a 2 DOF device
+    // Assumes a 2 DOF device (simulated runs the hub on capstan plants, no hardware needed)
 
-    PsychGui(int subject, PsychTest::WhichExp whichExp, PsychTest::WhichDof whichDOF, PsychTest::ControlType controller);
+    PsychGui(int subject, PsychTest::WhichExp whichExp, PsychTest::WhichDof whichDOF, PsychTest::ControlType controller, bool simulated = false);
 
     ~PsychGui();
 
@@ -54,9 +54,14 @@ public:
 
     int responseWindow(PsychTest::WhichStim whichStim);
 
-    void rampStimulus(double start, double end, double ramptime, double elapsed);
+    // Ramps are queued on the hub and played back every control tick; poll until they finish
+    void rampStimulus(double start, double end, double ramptime);
     
-    void rampLock(double start, double end, double ramptime, double elapsed);
+    void rampLock(double start, double end, double ramptime);
+
+    bool stimulusRamping();
+
+    bool lockRamping();
     
     // Method of Constant Stimuli Functions
 
@@ -124,6 +129,8 @@ public:
 
     void  getFNUpdate();
 
+    void setUserLimits();
+
     void userLimitsExceeded();
 
     void collectSensorData(PsychTest::WhichStim whichStim, int refOrder);
@@ -201,6 +208,8 @@ public:
     CMHub m_hub;
     std::shared_ptr<CM> m_cm_test;
     std::shared_ptr<CM> m_cm_lock;
+    std::uint64_t m_rampTest = 0;   // last queued ramp segment of the test dof
+    std::uint64_t m_rampLock = 0;   // last queued ramp segment of the lock dof
     CM::Params m_paramsTest;
     CM::Params m_paramsLock;
 
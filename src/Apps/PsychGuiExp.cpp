@@ -14,6 +14,7 @@ int main(int argc, char *argv[])
         ("t,tangential","Test the tangential/shear direction: -t")
         ("p,position","Test using position control: -p")
         ("f,force","Test using position control: -f")
+        ("x,simulate","Run on simulated hardware: -x")
         ("h,help","print help");
     
     auto result = options.parse(argc, argv);
@@ -65,7 +66,7 @@ int main(int argc, char *argv[])
         return 0;
     }
 
-    PsychGui gui(subject_num, whichExp, active_dof, active_control);
+    PsychGui gui(subject_num, whichExp, active_dof, active_control, result.count("x") > 0);
     gui.run();
    
     return 0;
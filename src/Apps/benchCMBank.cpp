@@ -0,0 +1,104 @@
+#include "CMBank.hpp"
+#include "CapstanModule.hpp"
+#include "Util/SimDaq.hpp"
+#include "Util/WorkerPool.hpp"
+#include <Mahi/Daq.hpp>
+#include <Mahi/Robo.hpp>
+#include <Mahi/Util.hpp>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+// Scaling benchmark for the fork-join device update (CMHub::setWorkers). Runs
+// CMBank::update back to back for a range of device and worker counts and prints
+// ticks/sec. Needs no hardware: the DAQ is a SimDaq with no plants attached and
+// devices stay disabled, so they skip their output writes, but commands, sensing, filters, the control law
+// and telemetry all run as they would on the hub. A second argument "validate"
+// runs the input filter banks in BiquadBank::Validate mode and reports any
+// outputs that differ from the scalar Biquads.
+
+using namespace mahi::daq;
+using namespace mahi::util;
+using namespace mahi::robo;
+
+int main(int argc, char const *argv[])
+{
+    const int ticks = argc > 1 ? std::atoi(argv[1]) : 20000;
+    const bool validate = argc > 2 && std::string(argv[2]) == "validate";
+    const std::vector<int> deviceCounts = {1, 2, 4, 8, 16, 32, 64};
+    const std::vector<int> workerCounts = {1, 2, 4, 8};
+
+    // this thread runs part 0 of every update, keep it on CPU 0
+    RtConfig pin;
+    pin.enabled      = true;
+    pin.priority     = 0;
+    pin.lockMemory   = false;
+    pin.prefaultHeap = 0;
+    pin.cpu          = 0;
+    applyRealTime(pin);
+
+    SimDaq daq;
+    std::vector<std::shared_ptr<CM>> devices;
+    std::vector<int> ids;
+    for (int id = 0; id < deviceCounts.back(); ++id) {
+        int ch = id % 8;
+        // CM owns (and deletes) its force sensor
+        AIForceSensor* sensor = new AIForceSensor();
+        sensor->set_force_calibration(1, 0, 0);
+        sensor->set_channel(&daq.AI[ch]);
+        CM::Io io = {
+            DOHandle(daq.DO, ch),
+            DIHandle(daq.DI, ch),
+            AOHandle(daq.AO, ch),
+            EncoderHandle(daq.encoder, ch),
+            *sensor,
+            Axis::AxisX,
+            &daq.velocity[ch],
+            &daq.velocity.velocities[ch]
+        };
+        auto cm = std::make_shared<CM>("cm_" + std::to_string(id), io, CM::Params());
+        // mix of controllers, as a typical rig would run
+        cm->setControlMode(id % 2 ? CM::ControlMode::Force : CM::ControlMode::Position);
+        cm->setControlValue(0.5);
+        devices.push_back(cm);
+        ids.push_back(id);
+    }
+
+    std::cout << "CMBank scaling (" << ticks << " ticks per point, " << (CMBank::simd() ? "AVX2" : "scalar") << " kernel)" << std::endl;
+    std::cout << std::setw(10) << "devices";
+    for (int workers : workerCounts)
+        std::cout << std::setw(14) << (std::to_string(workers) + " worker(s)");
+    std::cout << std::endl;
+
+    // device time keeps increasing across runs so velocity estimates stay sane
+    Time t = Time::Zero;
+    for (int n : deviceCounts) {
+        std::vector<std::shared_ptr<CM>> subset(devices.begin(), devices.begin() + n);
+        std::vector<int> subsetIds(ids.begin(), ids.begin() + n);
+        CMBank bank;
+        bank.assign(subsetIds, subset);
+        bank.attach();
+        if (validate)
+            bank.setFilterMode(BiquadBank::Validate);
+        std::cout << std::setw(10) << n;
+        for (int workers : workerCounts) {
+            // pin worker i to CPU i (scheduler left alone, no memory locking)
+            std::vector<int> cpus;
+            for (int i = 0; i < workers; ++i)
+                cpus.push_back(i);
+            WorkerPool pool(workers, pin, cpus);
+            for (int i = 0; i < ticks / 10; ++i, t += 1_ms)
+                bank.update(t, pool);
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < ticks; ++i, t += 1_ms)
+                bank.update(t, pool);
+            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::cout << std::setw(14) << std::fixed << std::setprecision(0) << ticks / elapsed;
+        }
+        if (validate)
+            std::cout << std::setw(14) << bank.filterMismatches() << " filter mismatches";
+        std::cout << std::endl;
+        bank.detach();
+    }
+    return 0;
+}
@@ -0,0 +1,562 @@
+#include "CMHub.hpp"
+#include "Util/AsyncLog.hpp"
+#include "Util/Biquad.hpp"
+#include "Util/BiquadBank.hpp"
+#include "Util/HybridTimer.hpp"
+#include "Util/LatencyHistogram.hpp"
+#include "Util/MedianFilter.hpp"
+#include "Util/SetpointStream.hpp"
+#include "Util/SpscQueue.hpp"
+#include "Util/TelemetryRing.hpp"
+#include "Util/Trajectory.hpp"
+#include <Mahi/Util.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Headless behaviour checks for the CM building blocks. Each check runs an
+// optimized component against a plain reference (or a known answer) and prints
+// pass/FAIL. Needs no hardware; returns nonzero if any check fails.
+
+using namespace mahi::util;
+
+namespace {
+    int failures = 0;
+
+    /// Formats a number as operator<< would (to_string hides small differences)
+    std::string num(double x) {
+        std::ostringstream ss;
+        ss << x;
+        return ss.str();
+    }
+
+    /// Prints a check result and counts failures
+    void check(bool ok, const std::string& what) {
+        std::cout << (ok ? "pass  " : "FAIL  ") << what << std::endl;
+        if (!ok)
+            failures++;
+    }
+
+    /// Biquad::butterworth against the mahi filter it replaced in CM
+    void checkButterworth() {
+        for (double Wn : {0.02, 0.2, 0.25}) {
+            Biquad biquad(Biquad::butterworth(Wn));
+            Butterworth butter(2, Wn, Butterworth::Lowpass);
+            double worst = 0;
+            for (int i = 0; i < 5000; ++i) {
+                // square wave plus chirp
+                double x = (i % 500 < 250 ? 1.0 : -1.0) + std::sin(1e-4 * i * i);
+                worst = std::max(worst, std::abs(biquad.update(x) - butter.update(x)));
+            }
+            check(worst < 1e-9, "Biquad matches Butterworth(2, " + num(Wn) + "), worst difference " + num(worst));
+        }
+    }
+
+    /// MedianFilter (Mediator heaps) against sorting the zero filled window, as the old filter did
+    void checkMedian() {
+        std::mt19937 rng(5);
+        // coarse values so the window is full of ties
+        std::uniform_int_distribution<int> level(-8, 8);
+        for (int N : {1, 2, 3, 4, 5, 31, 32}) {
+            MedianFilter median(N);
+            std::deque<double> window(N, 0.0);
+            int mismatches = 0;
+            for (int i = 0; i < 5000; ++i) {
+                double x = 0.5 * level(rng);
+                window.pop_front();
+                window.push_back(x);
+                std::vector<double> sorted(window.begin(), window.end());
+                std::sort(sorted.begin(), sorted.end());
+                mismatches += median.filter(x) != sorted[N / 2];
+            }
+            check(mismatches == 0, "MedianFilter(" + std::to_string(N) + ") matches a sorted window, " + std::to_string(mismatches) + " mismatches");
+        }
+        MedianFilter primed(7);
+        primed.prime(2.0);
+        check(primed.filter(-1.0) == 2.0 && primed.get_value() == 2.0, "MedianFilter::prime fills the window");
+    }
+
+    /// Running-sum moving averages against summing the window every sample
+    void checkAverage() {
+        std::mt19937 rng(6);
+        // large offset so an unsynchronized running sum would drift visibly
+        std::normal_distribution<double> noise(1000.0, 1.0);
+        AverageFilter<10> fixed;
+        DynamicAverageFilter dynamic(37);
+        std::deque<double> w10(10, 0.0), w37(37, 0.0);
+        double worst = 0;
+        for (int i = 0; i < 200000; ++i) {
+            double x = noise(rng);
+            w10.pop_front(); w10.push_back(x);
+            w37.pop_front(); w37.push_back(x);
+            double sum10 = 0, sum37 = 0;
+            for (double v : w10) sum10 += v;
+            for (double v : w37) sum37 += v;
+            worst = std::max(worst, std::abs(fixed.filter(x) - sum10 / 10));
+            worst = std::max(worst, std::abs(dynamic.filter(x) - sum37 / 37));
+        }
+        check(worst < 1e-9, "AverageFilter and DynamicAverageFilter match the window mean, worst difference " + num(worst));
+    }
+
+    /// HybridTimer margin rule, and deadlines kept in both wait modes
+    void checkHybridTimer() {
+        using us = std::chrono::microseconds;
+        const HybridTimer::Duration period = us(1000);
+        HybridTimer::Duration peak = HybridTimer::Duration::zero();
+        check(HybridTimer::tune_margin(us(0), peak, period) == HybridTimer::MinMargin, "HybridTimer margin starts at MinMargin");
+        check(HybridTimer::tune_margin(us(200), peak, period) == us(400), "HybridTimer margin is twice the oversleep");
+        // a new worst case raises the margin at once, quiet ticks let it decay back down
+        HybridTimer::Duration margin = us(400), last = margin;
+        bool monotonic = true;
+        int ticks = 0;
+        while (margin > HybridTimer::MinMargin && ticks < 10000) {
+            margin = HybridTimer::tune_margin(us(0), peak, period);
+            monotonic = monotonic && margin <= last;
+            last = margin;
+            ticks++;
+        }
+        check(monotonic && margin == HybridTimer::MinMargin && ticks > 1024,
+              "HybridTimer margin decays back to MinMargin in " + std::to_string(ticks) + " quiet ticks");
+        check(HybridTimer::tune_margin(us(5000), peak, period) == period, "HybridTimer margin is capped at the period");
+
+        for (HybridTimer::WaitMode mode : {HybridTimer::Busy, HybridTimer::Hybrid}) {
+            const char* name = mode == HybridTimer::Busy ? "Busy" : "Hybrid";
+            HybridTimer timer(hertz(1000), mode);
+            timer.set_skip_missed(true);
+            bool early = false;
+            for (int i = 0; i < 200; ++i) {
+                timer.wait();
+                early = early || timer.get_elapsed_time().as_microseconds() < timer.get_elapsed_time_ideal().as_microseconds();
+            }
+            check(!early, std::string("HybridTimer ") + name + " never returns before a deadline");
+            check(mode == HybridTimer::Hybrid || timer.get_sleep_ratio() == 0, std::string("HybridTimer ") + name + " sleeps only in Hybrid mode");
+            // a 5.5 period stall skips the passed deadlines instead of bursting through them
+            std::int64_t misses = timer.get_misses(), tick = timer.get_elapsed_ticks();
+            std::this_thread::sleep_for(us(5500));
+            timer.wait();
+            check(timer.get_misses() - misses >= 5 && timer.get_elapsed_ticks() - tick >= 6,
+                  std::string("HybridTimer ") + name + " counts and skips missed deadlines");
+        }
+    }
+
+    /// LatencyHistogram buckets and percentiles against exact values
+    void checkLatencyHistogram() {
+        // a value paired with a larger one is its own median, reported as the top of its bucket,
+        // which must hold the value and be within the 1/SubCount resolution
+        bool bounded = true, monotonic = true;
+        std::int64_t last = 0;
+        for (std::int64_t v = 0; v <= LatencyHistogram::MaxValue; v += 1 + v / 97) {
+            LatencyHistogram h;
+            h.record(v);
+            h.record(LatencyHistogram::MaxValue);
+            std::int64_t top = h.percentile(50);
+            bounded   = bounded && top >= v && top <= v + v / LatencyHistogram::SubCount;
+            monotonic = monotonic && top >= last;
+            last = top;
+        }
+        check(bounded && monotonic, "LatencyHistogram buckets hold their values to 1/32 and are ordered");
+
+        LatencyHistogram clamped;
+        clamped.record(-5);
+        clamped.record(LatencyHistogram::MaxValue * 4);
+        check(clamped.count() == 2 && clamped.percentile(0) == 0 && clamped.max() == LatencyHistogram::MaxValue,
+              "LatencyHistogram clamps values outside [0, MaxValue]");
+
+        std::mt19937 rng(13);
+        std::exponential_distribution<double> latency(1.0 / 200.0);
+        LatencyHistogram h;
+        std::vector<std::int64_t> values;
+        for (int i = 0; i < 100000; ++i) {
+            values.push_back((std::int64_t)latency(rng));
+            h.record(values.back());
+        }
+        std::sort(values.begin(), values.end());
+        bool close = true;
+        for (double p : {50.0, 99.0, 99.9, 100.0}) {
+            std::size_t rank = std::min(std::max<std::size_t>((std::size_t)(p / 100.0 * values.size() + 0.5), 1), values.size());
+            std::int64_t exact = values[rank - 1], reported = h.percentile(p);
+            close = close && reported >= exact && reported <= exact + exact / LatencyHistogram::SubCount;
+        }
+        check(close, "LatencyHistogram percentiles are within 1/32 above the exact percentiles");
+
+        LatencyHistogram coarse;
+        for (std::int64_t v : {0, 1, 2, 3, 1000, 1023, 1024})
+            coarse.record(v);
+        LatencyStats stats;
+        coarse.summarize(stats);
+        int total = 0;
+        for (int b : stats.bins)
+            total += b;
+        check(stats.bins[0] == 1 && stats.bins[1] == 1 && stats.bins[2] == 2 && stats.bins[10] == 2 && stats.bins[11] == 1 && total == 7,
+              "LatencyStats power-of-two bins count [2^(i-1), 2^i)");
+    }
+
+    /// Runs the overrun state machine over missed deadline counts per tick, counting
+    /// consecutive overruns and on time ticks as CMHub::handleOverrun does
+    std::vector<CMHub::OverrunMode> runOverrun(const CMHub::OverrunConfig& config, const std::vector<int>& missed,
+                                               CMHub::OverrunMode mode = CMHub::Nominal) {
+        std::vector<CMHub::OverrunMode> modes;
+        int overruns = 0, onTime = 0;
+        for (int m : missed) {
+            if (m > 0) { overruns++; onTime = 0; }
+            else       { overruns = 0; onTime++; }
+            mode = CMHub::nextOverrunMode(config, mode, m, overruns, onTime);
+            modes.push_back(mode);
+        }
+        return modes;
+    }
+
+    /// Overrun policies walk the documented modes
+    void checkOverrun() {
+        CMHub::OverrunConfig config;
+        config.holdAfter    = 3;
+        config.disableAfter = 10;
+        config.recoverAfter = 100;
+        std::vector<int> burst(12, 1);
+        std::vector<int> recover(100, 0);
+
+        config.policy = CMHub::CatchUp;
+        auto modes = runOverrun(config, burst);
+        check(std::all_of(modes.begin(), modes.end(), [](CMHub::OverrunMode m) { return m == CMHub::Nominal; }),
+              "CatchUp stays Nominal through overruns");
+
+        config.policy = CMHub::Shed;
+        std::vector<int> ticks = burst;
+        ticks.insert(ticks.end(), recover.begin(), recover.end());
+        modes = runOverrun(config, ticks);
+        check(modes[0] == CMHub::Shedding && modes[11] == CMHub::Shedding && modes[110] == CMHub::Shedding && modes[111] == CMHub::Nominal,
+              "Shed sheds on the first overrun and recovers after recoverAfter on time ticks");
+
+        config.policy = CMHub::SafeHold;
+        modes = runOverrun(config, ticks);
+        check(modes[1] == CMHub::Shedding && modes[2] == CMHub::Holding && modes[8] == CMHub::Holding && modes[9] == CMHub::Disabled
+              && modes[110] == CMHub::Disabled && modes[111] == CMHub::Nominal,
+              "SafeHold holds after holdAfter, disables after disableAfter and recovers after recoverAfter");
+
+        // a single on time tick does not reset the hold, and a new run of overruns never steps it down
+        modes = runOverrun(config, {1, 1, 1, 1, 0, 1, 1});
+        check(modes[3] == CMHub::Holding && modes[4] == CMHub::Holding && modes[6] == CMHub::Holding,
+              "SafeHold never steps down before recovering");
+
+        config.policy = CMHub::CatchUp;
+        modes = runOverrun(config, {0}, CMHub::Holding);
+        check(modes[0] == CMHub::Nominal, "switching to CatchUp returns to Nominal on the next on time tick");
+    }
+
+    /// Linear 0 -> 1 over 1 s, hold 0.5 s, -1 at 2 units/s, min jerk back to 0 over 1 s, as a function of time since the start
+    double chainValue(double t) {
+        if (t < 1.0) return t;
+        if (t < 1.5) return 1.0;
+        if (t < 2.5) return 1.0 - 2.0 * (t - 1.5);
+        if (t < 3.5) {
+            double tau = t - 2.5;
+            return -1.0 + tau * tau * tau * (10.0 - 15.0 * tau + 6.0 * tau * tau);
+        }
+        return 0.0;
+    }
+
+    /// Trajectory segments chained end to end play back the analytic profile at any tick rate
+    void checkTrajectory() {
+        auto queue = [](Trajectory& trajectory) {
+            Trajectory::Segment s;
+            s.profile = Trajectory::Linear;           s.target = 1;  s.duration = 1.0; trajectory.push(s);
+            s.profile = Trajectory::Hold;                            s.duration = 0.5; trajectory.push(s);
+            s.profile = Trajectory::ConstantVelocity; s.target = -1; s.speed = 2.0;    trajectory.push(s);
+            s.profile = Trajectory::MinJerk;          s.target = 0;  s.duration = 1.0; trajectory.push(s);
+        };
+        // a tick that does not divide the segment lengths, and one longer than a whole segment
+        for (double dt : {0.003, 0.7}) {
+            Trajectory trajectory;
+            queue(trajectory);
+            const double start = 10.0;
+            double value = 0, worst = 0;
+            std::size_t completed, total = 0;
+            for (double t = start; t < start + 5.0; t += dt) {
+                value = trajectory.evaluate(t, value, completed);
+                total += completed;
+                worst = std::max(worst, std::abs(value - chainValue(t - start)));
+            }
+            check(worst < 1e-9 && total == 4 && !trajectory.active(),
+                  "Trajectory chain matches the analytic profile at " + num(dt) + " s ticks, worst difference " + num(worst));
+        }
+
+        // a queue emptied and refilled later starts from the current setpoint at the current time
+        Trajectory trajectory;
+        std::size_t completed;
+        Trajectory::Segment s;
+        s.profile = Trajectory::Linear; s.target = 2; s.duration = 1.0;
+        trajectory.push(s);
+        trajectory.evaluate(0.0, 1.0, completed);
+        double mid = trajectory.evaluate(0.5, 1.0, completed);
+        double end = trajectory.evaluate(5.0, mid, completed);
+        trajectory.push(s);
+        double restart = trajectory.evaluate(6.0, end, completed);
+        check(std::abs(mid - 1.5) < 1e-12 && end == 2.0 && restart == 2.0 && trajectory.active(),
+              "Trajectory restarts from the current setpoint after the queue runs dry");
+        check(trajectory.clear() == 1 && !trajectory.active(), "Trajectory::clear drops the running segment");
+
+        Trajectory small(2);
+        check(small.push(s) && small.push(s) && !small.push(s), "Trajectory::push refuses segments past capacity");
+    }
+
+    /// SetpointStream reconstructs known signals delay seconds behind the evaluation time
+    void checkSetpointStream() {
+        const double delay = 0.02;
+        auto sample = [](double time, double value) {
+            SetpointStream::Sample s;
+            s.time  = time;
+            s.value = value;
+            return s;
+        };
+
+        // Linear is exact for a ramp, whatever the sample spacing
+        std::mt19937 rng(22);
+        std::uniform_real_distribution<double> gap(0.002, 0.015);
+        SetpointStream linear;
+        linear.configure(SetpointStream::Linear, delay);
+        auto ramp = [](double t) { return 2.0 * t + 1.0; };
+        double stamp = 0, worst = 0;
+        for (int tick = 0; tick < 2000; ++tick) {
+            double t = 0.001 * tick;
+            while (stamp <= t) {
+                linear.push(sample(stamp, ramp(stamp)));
+                stamp += gap(rng);
+            }
+            double value = linear.evaluate(t);
+            if (t >= delay)
+                worst = std::max(worst, std::abs(value - ramp(t - delay)));
+        }
+        check(worst < 1e-9, "SetpointStream Linear reproduces a jittered ramp, worst difference " + num(worst));
+
+        // Cubic (finite difference slopes) is exact for a parabola on even spacing
+        SetpointStream cubic(128);
+        cubic.configure(SetpointStream::Cubic, delay);
+        auto parabola = [](double t) { return 3.0 * t * t - t; };
+        for (int i = 0; i <= 100; ++i)
+            cubic.push(sample(0.01 * i, parabola(0.01 * i)));
+        worst = 0;
+        for (double t = 0.05; t < 0.95; t += 0.0007)
+            worst = std::max(worst, std::abs(cubic.evaluate(t + delay) - parabola(t)));
+        check(worst < 1e-9, "SetpointStream Cubic reproduces an evenly sampled parabola, worst difference " + num(worst));
+
+        // past the newest sample the stream holds it and reports starvation
+        check(cubic.evaluate(5.0) == parabola(1.0), "SetpointStream holds the newest value instead of extrapolating");
+        cubic.update(1.0);
+        check(cubic.jitter().starved > 0 && std::abs(cubic.jitter().interval - 0.01) < 1e-9 && cubic.jitter().stdDev < 1e-6,
+              "SetpointStream reports feed interval, jitter and starvation");
+
+        // stale samples are ignored, and rebasing moves the whole stream in time
+        SetpointStream stream;
+        stream.configure(SetpointStream::Linear, 0);
+        stream.push(sample(1.0, 0.0));
+        stream.push(sample(2.0, 1.0));
+        stream.push(sample(1.5, 9.0));
+        double before = stream.evaluate(1.5);
+        stream.rebase(-1.0);
+        check(before == 0.5 && stream.evaluate(0.5) == 0.5, "SetpointStream ignores stale samples and rebases onto a new clock");
+    }
+
+    /// Supervisor trip bits, alone and combined, then end to end on a simulated hub
+    void checkSupervisor() {
+        // velocity 100 of 200, torque 0.1 of 0.4, force in [0, 10], position in [-15, 0]
+        auto bits = [](double vel, double torque, double force, double pos) {
+            return CMBank::tripBits(vel, 200, torque, 0.4, force, 0, 10, pos, -15, 0);
+        };
+        check(bits(100, 0.1, 5, -5) == CM::Trip::NoTrip && bits(-200, -0.4, 10, 0) == CM::Trip::NoTrip,
+              "Supervisor passes values inside and on their limits");
+        check(bits(-201, 0.1, 5, -5) == CM::Trip::VelocityLimit && bits(100, -0.5, 5, -5) == CM::Trip::TorqueLimit
+              && bits(100, 0.1, -1, -5) == CM::Trip::ForceLimit && bits(100, 0.1, 11, -5) == CM::Trip::ForceLimit
+              && bits(100, 0.1, 5, -16) == CM::Trip::PositionLimit && bits(100, 0.1, 5, 1) == CM::Trip::PositionLimit,
+              "Supervisor sets one bit per violated limit");
+        check(bits(300, 1.0, 20, 5) == (CM::Trip::VelocityLimit | CM::Trip::TorqueLimit | CM::Trip::ForceLimit | CM::Trip::PositionLimit),
+              "Supervisor combines the bits of every violated limit");
+
+        // two simulated DOFs at rest (0 N, 0 mm), each given a user limit that excludes rest
+        CMHub hub(1000, true);
+        hub.createDevice(0, 0, 0, 0, 0, Axis::AxisZ, "FT06833.cal", {0,1,2,3,4,5}, 0);
+        hub.createDevice(1, 2, 2, 1, 1, Axis::AxisX, "FT06833.cal", {0,1,2,3,4,5}, 0);
+        auto normal = hub.getDevice(0), tangential = hub.getDevice(1);
+        if (!normal || !tangential) {
+            check(false, "Supervisor trips devices on a simulated hub (devices not created)");
+            return;
+        }
+        normal->setUserForceLimits(5, 10);
+        tangential->setUserPositionLimits(1, 2);
+        hub.start();
+        normal->enable();
+        tangential->enable();
+        for (int i = 0; i < 100 && (normal->is_enabled() || tangential->is_enabled()); ++i)
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        std::uint64_t cursor = 0;
+        std::vector<CMHub::Event> events;
+        hub.readEvents(cursor, events);
+        hub.stop();
+        int normalEvent = 0, tangentialEvent = 0;
+        for (auto& e : events) {
+            if (e.type == CMHub::Event::SafetyTrip)
+                (e.device == 0 ? normalEvent : tangentialEvent) |= e.cause;
+        }
+        check(!normal->is_enabled() && normal->getTripCause() == CM::Trip::ForceLimit && normalEvent == CM::Trip::ForceLimit
+              && !tangential->is_enabled() && tangential->getTripCause() == CM::Trip::PositionLimit && tangentialEvent == CM::Trip::PositionLimit,
+              "Supervisor disables each simulated device for its own limit and logs it");
+    }
+
+    /// BiquadBank sections against independent Biquads, bit for bit, in every mode
+    void checkBiquadBank() {
+        const std::size_t sections = 11;  // not a multiple of 4, so the last block is padded
+        std::mt19937 rng(25);
+        std::uniform_real_distribution<double> cutoff(0.01, 0.9), input(-10, 10);
+        for (BiquadBank::Mode mode : {BiquadBank::Vector, BiquadBank::Reference, BiquadBank::Validate}) {
+            BiquadBank bank(sections);
+            bank.set_mode(mode);
+            std::vector<Biquad> biquads;
+            for (std::size_t i = 0; i < sections; ++i) {
+                biquads.emplace_back(Biquad::butterworth(cutoff(rng)));
+                bank.set_coefficients(i, biquads[i].get_coefficients());
+            }
+            int mismatches = 0;
+            for (int tick = 0; tick < 2000; ++tick) {
+                // swap a section's coefficients mid-run, as a CM params change would
+                if (tick == 1000) {
+                    biquads[5].set_coefficients(Biquad::butterworth(0.5));
+                    bank.set_coefficients(5, biquads[5].get_coefficients());
+                }
+                for (std::size_t i = 0; i < sections; ++i)
+                    bank.input(i) = input(rng);
+                // two ranges, as two workers would split the bank
+                bank.update(0, 8);
+                bank.update(8, sections);
+                for (std::size_t i = 0; i < sections; ++i) {
+                    double y = biquads[i].update(bank.input(i)), out = bank.output(i);
+                    mismatches += std::memcmp(&y, &out, sizeof(double)) != 0;
+                }
+            }
+            const char* name = mode == BiquadBank::Vector ? "Vector" : mode == BiquadBank::Reference ? "Reference" : "Validate";
+            check(mismatches == 0 && bank.mismatches() == 0,
+                  std::string("BiquadBank ") + name + " matches Biquad bit for bit, " + std::to_string(mismatches) + " mismatches");
+        }
+
+        // state handed from a Biquad to the bank and back continues the same filter
+        Biquad a(Biquad::butterworth(0.1)), b(Biquad::butterworth(0.1));
+        for (int i = 0; i < 50; ++i) {
+            a.update(i % 7);
+            b.update(i % 7);
+        }
+        BiquadBank bank(1);
+        bank.set_coefficients(0, b.get_coefficients());
+        bank.set_state(0, b.get_state());
+        bank.input(0) = 3.0;
+        bank.update();
+        b.set_state(bank.get_state(0));
+        check(a.update(3.0) == bank.output(0) && a.update(1.0) == b.update(1.0), "BiquadBank takes over and hands back Biquad state");
+    }
+
+    /// TelemetryRing readers never see a torn or reordered record while the producer laps them
+    void checkTelemetryRing() {
+        struct Record { std::uint64_t index, twice, thrice; };
+        TelemetryRing<Record> ring(8);
+        for (std::uint64_t i = 0; i < 20; ++i)
+            ring.push_back(Record{i, 2 * i, 3 * i});
+        std::vector<Record> out;
+        ring.snapshot(out);
+        bool latest = out.size() == 8 && ring.head() == 20;
+        for (std::size_t k = 0; latest && k < out.size(); ++k)
+            latest = out[k].index == 12 + k;
+        check(latest, "TelemetryRing keeps the newest capacity() records, oldest first");
+
+        const std::uint64_t count = 2000000;
+        TelemetryRing<Record> shared(64);
+        std::thread producer([&]() {
+            for (std::uint64_t i = 0; i < count; ++i)
+                shared.push_back(Record{i, 2 * i, 3 * i});
+        });
+        std::uint64_t cursor = 0, received = 0, torn = 0, reordered = 0, last = 0;
+        while (cursor < count) {
+            out.clear();
+            shared.read_since(cursor, out);
+            for (auto& r : out) {
+                torn += r.twice != 2 * r.index || r.thrice != 3 * r.index;
+                reordered += received > 0 && r.index <= last;
+                last = r.index;
+                received++;
+            }
+        }
+        producer.join();
+        check(received > 0 && torn == 0 && reordered == 0,
+              "TelemetryRing concurrent reads, " + std::to_string(received) + " records, " + std::to_string(torn) + " torn, "
+              + std::to_string(reordered) + " out of order");
+    }
+
+    /// SpscQueue delivers every item once, in order, across threads, and reports full and empty
+    void checkSpscQueue() {
+        SpscQueue<int> small(5);
+        int pushed = 0, item = 0;
+        while (small.push(pushed))
+            pushed++;
+        bool bounded = pushed == (int)small.capacity() && small.capacity() == 8;
+        for (int i = 0; bounded && i < pushed; ++i)
+            bounded = small.pop(item) && item == i;
+        check(bounded && small.empty() && !small.pop(item), "SpscQueue rounds capacity up, stops when full, pops in order");
+
+        const std::uint64_t count = 1000000;
+        SpscQueue<std::uint64_t> queue(64);
+        std::thread producer([&]() {
+            for (std::uint64_t i = 0; i < count; ++i) {
+                while (!queue.push(i))
+                    std::this_thread::yield();
+            }
+        });
+        std::uint64_t expected = 0, wrong = 0, value = 0;
+        while (expected < count) {
+            if (queue.pop(value))
+                wrong += value != expected++;
+            else
+                std::this_thread::yield();
+        }
+        producer.join();
+        check(wrong == 0 && queue.empty(), "SpscQueue passes " + std::to_string(count) + " items between threads, " + std::to_string(wrong) + " out of order");
+    }
+
+    /// AsyncLog suppresses repeats per source, so one device's repeats never hide another's
+    void checkAsyncLog() {
+        AsyncLog log(16);
+        static AsyncLog::Format format(Info, "checkCM: AsyncLog source {}", 60.0);
+        int a = 0, b = 0;
+        bool admitted = log.log(&a, format, "a") && !log.log(&a, format, "a")
+                     && log.log(&b, format, "b") && !log.log(&b, format, "b")
+                     && log.log(format, "none") && !log.log(format, "none");
+        for (int i = 0; i < 100 && log.stats().written < 3; ++i)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        AsyncLog::Stats stats = log.stats();
+        check(admitted && stats.written == 3 && stats.suppressed == 3 && stats.dropped == 0,
+              "AsyncLog rate limits each source separately, " + std::to_string(stats.written) + " written, "
+              + std::to_string(stats.suppressed) + " suppressed");
+    }
+}
+
+int main(int argc, char const *argv[])
+{
+    checkButterworth();
+    checkMedian();
+    checkAverage();
+    checkHybridTimer();
+    checkLatencyHistogram();
+    checkOverrun();
+    checkTrajectory();
+    checkSetpointStream();
+    checkSupervisor();
+    checkBiquadBank();
+    checkTelemetryRing();
+    checkSpscQueue();
+    checkAsyncLog();
+    std::cout << (failures == 0 ? "all checks passed" : std::to_string(failures) + " checks failed") << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,89 @@
+#include "CMReplay.hpp"
+#include <Mahi/Util.hpp>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+
+// Replays recorded timeseries (e.g. data/MA/*timeseries*.csv) through CMReplay
+// and writes the regenerated force, dFdt and controller signals next to each
+// input as *_replay.csv. Use -p to evaluate exported CM Params.
+
+using namespace mahi::util;
+namespace fs = std::filesystem;
+
+int main(int argc, char *argv[])
+{
+    Options options("replayRecordings.exe","Replay recorded sessions through a CM");
+    options.add_options()
+        ("i,input","Recording or directory of recordings: -i data/MA",value<std::string>())
+        ("p,params","CM Params JSON to evaluate: -p params.json",value<std::string>())
+        ("t,tangential","Replay the shear channels instead of normal: -t")
+        ("m,mode","Control mode torque, position or force: -m force",value<std::string>())
+        ("r,reference","Column used as the control reference: -r NormF",value<std::string>())
+        ("h,help","print help");
+
+    auto result = options.parse(argc, argv);
+    if (result.count("help") > 0 || result.count("input") == 0) {
+        print("{}",options.help());
+        return 0;
+    }
+
+    CM::ControlMode mode = CM::ControlMode::Torque;
+    if (result.count("mode")) {
+        std::string m = result["mode"].as<std::string>();
+        if (m == "position")
+            mode = CM::ControlMode::Position;
+        else if (m == "force")
+            mode = CM::ControlMode::Force;
+    }
+
+    CMReplay replay(CM::Params(), mode);
+    if (result.count("params") && !replay.importParams(result["params"].as<std::string>())) {
+        LOG(Error) << "Could not import CM Params. Exiting code.";
+        return 1;
+    }
+
+    bool shear = result.count("tangential") > 0;
+    std::vector<std::string> files;
+    fs::path input(result["input"].as<std::string>());
+    if (fs::is_directory(input)) {
+        for (auto& entry : fs::recursive_directory_iterator(input)) {
+            std::string name = entry.path().filename().string();
+            if (entry.is_regular_file() && name.find("timeseries") != std::string::npos && name.find("_replay") == std::string::npos)
+                files.push_back(entry.path().string());
+        }
+    }
+    else {
+        files.push_back(input.string());
+    }
+    std::sort(files.begin(), files.end());
+
+    std::size_t rows = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (auto& file : files) {
+        CMReplay::Recording recording;
+        if (!CMReplay::load(file, recording))
+            continue;
+        // older sessions name the channels Fn, Ft, deltaN, deltaN (the second is the shear position)
+        CMReplay::Channels channels;
+        if (recording.column("NormF") >= 0) {
+            channels.force    = shear ? "ShearF" : "NormF";
+            channels.position = shear ? "ShearP" : "NormP";
+        }
+        else {
+            channels.force    = shear ? "Ft" : "Fn";
+            channels.position = shear ? "deltaN_2" : "deltaN";
+        }
+        if (result.count("reference"))
+            channels.reference = result["reference"].as<std::string>();
+        std::vector<CMReplay::Sample> samples;
+        if (!replay.run(recording, channels, samples))
+            continue;
+        fs::path out = fs::path(file).replace_extension("");
+        CMReplay::save(out.string() + "_replay.csv", samples);
+        rows += samples.size();
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    print("Replayed {} rows from {} recordings in {:.3f} s", rows, files.size(), elapsed);
+    return 0;
+}
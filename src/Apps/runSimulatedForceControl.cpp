@@ -0,0 +1,80 @@
+#include "CMHub.hpp"
+#include "CapstanModule.hpp"
+#include <Mahi/Robo.hpp>
+#include <Mahi/Util.hpp>
+
+// Headless force control on a simulated hub: normal and tangential capstan
+// modules press into modelled skin (see CapstanPlant), no DAQ required.
+// Each DOF loads its calibration file, whose sign flips match the wiring the
+// hub gives its plant. Returns nonzero if the normal DOF does not settle near
+// its force target.
+
+using namespace mahi::util;
+using namespace mahi::robo;
+
+int main(int argc, char *argv[])
+{
+    Options options("runSimulatedForceControl.exe","Force control on simulated capstan modules");
+    options.add_options()
+        ("c,calibs","Directory holding dof_normal.json and dof_tangential.json: -c calibs/CM",value<std::string>())
+        ("h,help","print help");
+
+    auto result = options.parse(argc, argv);
+    if (result.count("help") > 0) {
+        print("{}",options.help());
+        return 0;
+    }
+    std::string calibs = result.count("calibs") ? result["calibs"].as<std::string>() : "calibs/CM";
+
+    // make a simulated hub with the usual normal and tangential wiring
+    CMHub hub(1000, true);
+
+    int id_n = 0;
+    hub.createDevice(id_n, 0, 0, 0, 0, Axis::AxisZ, "FT06833.cal", {0,1,2,3,4,5},0);
+    auto cm_n = hub.getDevice(id_n);
+
+    int id_t = 1;
+    hub.createDevice(id_t, 2, 2, 1, 1, Axis::AxisX, "FT06833.cal", {0,1,2,3,4,5},0);
+    auto cm_t = hub.getDevice(id_t);
+
+    if (!cm_n->importParams(calibs + "/dof_normal.json") || !cm_t->importParams(calibs + "/dof_tangential.json")) {
+        LOG(Error) << "Could not import CM calibrations from " << calibs << ". Exiting code.";
+        return 1;
+    }
+
+    // keep the calibrated signs and motor constants, widen the force range for the step
+    for (auto& cm : {cm_n, cm_t}) {
+        CM::Params params = cm->getParams();
+        params.forceMin           = -5;   // [N]
+        params.forceMax           = 5;    // [N]
+        params.forceKp            = 0.01;
+        params.forceKff           = 0.2;  // about the spool radius [Nm/N] over torqueMax
+        params.velocityMax        = params.motorMaxSpeed;  // [deg/s] the hub supervisor checks motor velocity every tick
+        cm->setParams(params);
+        cm->setControlMode(CM::ControlMode::Force);
+        cm->setControlValue(0.5);  // 0 N
+    }
+
+    hub.start();
+    cm_n->enable();
+    cm_t->enable();
+
+    // step to 1 N normal and 0.5 N tangential
+    double target_n = 1.0, target_t = 0.5;
+    cm_n->setControlValue(cm_n->scaleRefToCtrlValue(target_n));
+    cm_t->setControlValue(cm_t->scaleRefToCtrlValue(target_t));
+
+    Timer timer(100_Hz);
+    Time t;
+    while (t < 2_s) {
+        t = timer.get_elapsed_time();
+        print("t = {:.2f} s  normal {:.3f} N  tangential {:.3f} N", t.as_seconds(), cm_n->getForce(), cm_t->getForce());
+        timer.wait();
+    }
+
+    double error = std::abs(cm_n->getForce() - target_n);
+    cm_n->disable();
+    cm_t->disable();
+    hub.stop();
+    return error < 0.25 * target_n ? 0 : 1;
+}
@@ -144,12 +144,12 @@ public:
         ImGui::Separator();
         
         cm_n->setForceGains(kp1/1e6,0,kd1/1e6);
-        cm_n->m_params.forceKff = forceKff1;      
+        cm_n->setForceFeedForward(forceKff1);      
         cm_n->setControlValue(cm_n->scaleRefToCtrlValue(f_ref1));
         cm_n->limits_exceeded();
 
         cm_t->setForceGains(kp2/1e6,0,kd2/1e6);
-        cm_t->m_params.forceKff = forceKff2;  
+        cm_t->setForceFeedForward(forceKff2);  
         cm_t->setControlValue(cm_t->scaleRefToCtrlValue(f_ref2));
         cm_t->limits_exceeded();
 
@@ -0,0 +1,466 @@
+#include "CMBank.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+using namespace mahi::util;
+
+void CMBank::Lanes::resize(std::size_t n) {
+    for (auto* v : {&ctrl, &meas, &dmeas, &active,
+                    &filtCtrl, &cb0, &cb1, &cb2, &ca1, &ca2, &cz1, &cz2, &cy,
+                    &offset, &range, &kp, &kd, &kff, &hasFF, &torqueLaw,
+                    &filtOut, &ob0, &ob1, &ob2, &oa1, &oa2, &oz1, &oz2, &oy,
+                    &sign, &ctrlFiltered, &torque, &volts,
+                    &on, &vel, &force, &pos, &cmd})
+        v->assign(n, 0.0);
+    const double inf = std::numeric_limits<double>::infinity();
+    for (auto* v : {&velMax, &torqueMax, &forceMax, &posMax})
+        v->assign(n, inf);
+    for (auto* v : {&forceMin, &posMin})
+        v->assign(n, -inf);
+    // keep padding lanes finite
+    for (auto* v : {&divisor, &ktc, &gain})
+        v->assign(n, 1.0);
+}
+
+CMBank::CMBank() { }
+
+void CMBank::assign(const std::vector<int>& ids, const std::vector<std::shared_ptr<CM>>& devices) {
+    m_ids     = ids;
+    m_devices = devices;
+    const std::size_t n = m_devices.size();
+    m_lanes.resize((n + 3) & ~std::size_t(3));
+    m_versions.assign(n, 0);
+    m_sources.assign(n, NoSource);
+    m_custom.assign(n, 0);
+    m_trips.assign(n, 0);
+    m_velocityBank.resize(n);
+    m_forceBank.resize(n);
+    m_dFdtBank.resize(n);
+    m_forceBanked.assign(n, 0);
+    m_dFdtBanked.assign(n, 0);
+    m_timing.assign(n, TimingStats());
+    m_phase.assign(n, std::chrono::steady_clock::duration::zero());
+}
+
+void CMBank::attach() {
+    for (std::size_t i = 0; i < m_devices.size(); ++i) {
+        load(i);
+        pull(i);
+    }
+}
+
+void CMBank::detach() {
+    for (std::size_t i = 0; i < m_devices.size(); ++i)
+        push(i);
+}
+
+std::size_t CMBank::size() const {
+    return m_devices.size();
+}
+
+bool CMBank::simd() {
+#ifdef __AVX2__
+    return true;
+#else
+    return false;
+#endif
+}
+
+void CMBank::setFilterMode(BiquadBank::Mode mode) {
+    for (auto* bank : {&m_velocityBank, &m_forceBank, &m_dFdtBank})
+        bank->set_mode(mode);
+}
+
+std::uint64_t CMBank::filterMismatches() const {
+    return m_velocityBank.mismatches() + m_forceBank.mismatches() + m_dFdtBank.mismatches();
+}
+
+std::size_t CMBank::getTiming(int* ids, TimingStats* devices, std::size_t max, TimingStats& kernel) const {
+    std::size_t n = std::min(m_devices.size(), max);
+    for (std::size_t i = 0; i < n; ++i) {
+        ids[i] = m_ids[i];
+        devices[i] = m_timing[i];
+    }
+    kernel = m_kernelTiming;
+    return n;
+}
+
+void CMBank::resetTiming() {
+    for (auto& timing : m_timing)
+        timing.reset();
+    m_kernelTiming.reset();
+}
+
+void CMBank::update(const Time& t, Tick tick) {
+    m_tick = tick;
+    updateRange(t, 0, m_devices.size());
+}
+
+void CMBank::update(const Time& t, WorkerPool& pool, Tick tick) {
+    m_tick = tick;
+    if (pool.size() < 2 || m_devices.size() <= 8) {
+        updateRange(t, 0, m_devices.size());
+        return;
+    }
+    m_tickTime = t;
+    pool.run(&CMBank::updatePart, this);
+}
+
+void CMBank::updatePart(void* bank, int part, int parts) {
+    CMBank&           self   = *static_cast<CMBank*>(bank);
+    const std::size_t n      = self.m_devices.size();
+    const std::size_t blocks = (n + 7) / 8;
+    std::size_t begin = std::min(n, blocks * part / parts * 8);
+    std::size_t end   = std::min(n, blocks * (part + 1) / parts * 8);
+    if (begin < end)
+        self.updateRange(self.m_tickTime, begin, end);
+}
+
+void CMBank::updateRange(const Time& t, std::size_t begin, std::size_t end) {
+    // commands, sensors and per tick inputs
+    sense(t, begin, end);
+    // control law for every DOF (kernel timing is kept by the range holding DOF 0)
+    CM_TIMING_BEGIN(kernel)
+#ifdef __AVX2__
+    kernelAvx2(begin, (end + 3) & ~std::size_t(3));
+#else
+    kernelScalar(begin, end);
+#endif
+#ifdef CM_TIMING
+    if (begin == 0)
+        m_kernelTiming.add(std::chrono::steady_clock::now() - kernel);
+#endif
+    // outputs, then limits on what was just commanded
+    for (std::size_t i = begin; i < end; ++i) {
+        CM_TIMING_BEGIN(scatterStart)
+        scatter(i);
+#ifdef CM_TIMING
+        m_phase[i] += std::chrono::steady_clock::now() - scatterStart;
+#endif
+    }
+    if (m_tick.supervise)
+        supervise(begin, end);
+    else
+        std::fill(m_trips.begin() + begin, m_trips.begin() + end, 0);
+    // telemetry, and trips once the device is unlocked (disable takes its lock)
+    for (std::size_t i = begin; i < end; ++i) {
+        CM_TIMING_BEGIN(endStart)
+        CM& cm = *m_devices[i];
+        cm.endUpdate(t, m_tick.telemetry);
+#ifdef TASBI_THREAD_SAFE
+        cm.m_mutex.unlock();
+#endif
+        if (m_trips[i])
+            cm.trip(m_trips[i]);
+#ifdef CM_TIMING
+        m_timing[i].add(m_phase[i] + (std::chrono::steady_clock::now() - endStart));
+#endif
+    }
+}
+
+void CMBank::sense(const Time& t, std::size_t begin, std::size_t end) {
+    // commands and raw sensors
+    for (std::size_t i = begin; i < end; ++i) {
+        CM_TIMING_BEGIN(senseStart)
+        CM& cm = *m_devices[i];
+#ifdef TASBI_THREAD_SAFE
+        cm.m_mutex.lock();
+#endif
+        cm.beginUpdate(t, false);
+        if (cm.m_configVersion != m_versions[i])
+            load(i);
+        m_velocityBank.input(i) = cm.senseEncoder(t);
+        m_forceBank.input(i)    = cm.senseForce();
+#ifdef CM_TIMING
+        m_phase[i] = std::chrono::steady_clock::now() - senseStart;
+#endif
+    }
+    m_velocityBank.update(begin, end);
+    m_forceBank.update(begin, end);
+    // filtered force feeds the derivative
+    for (std::size_t i = begin; i < end; ++i) {
+        CM_TIMING_BEGIN(forceStart)
+        CM& cm = *m_devices[i];
+        cm.senseVelocity(m_velocityBank.output(i));
+        if (m_forceBanked[i]) {
+            cm.m_sample.forceFiltered = m_forceBank.output(i);
+            cm.m_forceFilter.set_value(cm.m_sample.forceFiltered);
+        }
+        else {
+            cm.m_sample.forceFiltered = cm.m_forceFilter.filter(cm.m_sample.force);
+        }
+        m_dFdtBank.input(i) = cm.differentiateForce(t);
+#ifdef CM_TIMING
+        m_phase[i] += std::chrono::steady_clock::now() - forceStart;
+#endif
+    }
+    m_dFdtBank.update(begin, end);
+    for (std::size_t i = begin; i < end; ++i) {
+        CM_TIMING_BEGIN(gatherStart)
+        CM& cm = *m_devices[i];
+        if (m_dFdtBanked[i]) {
+            cm.m_sample.dFdtFiltered = m_dFdtBank.output(i);
+            cm.m_dFdtFilter.set_value(cm.m_sample.dFdtFiltered);
+        }
+        else {
+            cm.m_sample.dFdtFiltered = cm.m_dFdtFilter.filter(cm.m_sample.dFdt);
+        }
+        gather(i);
+#ifdef CM_TIMING
+        m_phase[i] += std::chrono::steady_clock::now() - gatherStart;
+#endif
+    }
+}
+
+void CMBank::supervise(std::size_t begin, std::size_t end) {
+    Lanes& L = m_lanes;
+    for (std::size_t i = begin; i < end; ++i)
+        L.cmd[i] = m_devices[i]->m_torque;
+    for (std::size_t i = begin; i < end; ++i) {
+        int cause = tripBits(L.vel[i], L.velMax[i], L.cmd[i], L.torqueMax[i], L.force[i], L.forceMin[i], L.forceMax[i],
+                             L.pos[i], L.posMin[i], L.posMax[i]);
+        m_trips[i] = cause & -(int)(L.on[i] != 0.0);
+    }
+}
+
+void CMBank::load(std::size_t i) {
+    CM&               cm = *m_devices[i];
+    const CM::Params& p  = cm.m_params;
+    Lanes&            L  = m_lanes;
+    // control value filter
+    Biquad::Coefficients c = cm.m_ctrlFilter.get_coefficients();
+    L.filtCtrl[i] = p.filterControlValue ? 1.0 : 0.0;
+    L.cb0[i] = c.b0; L.cb1[i] = c.b1; L.cb2[i] = c.b2; L.ca1[i] = c.a1; L.ca2[i] = c.a2;
+    // control law (mirrors CM::scaleCtrlValue and the CM::runLoop overloads)
+    L.kp[i] = L.kd[i] = L.kff[i] = L.hasFF[i] = L.torqueLaw[i] = 0.0;
+    L.divisor[i] = 1.0;
+    m_custom[i]  = cm.m_ctrlMode == CM::ControlMode::Custom;
+    switch (cm.m_ctrlMode) {
+        case CM::ControlMode::Position:
+            m_sources[i] = Position;
+            L.offset[i]  = p.positionMin;
+            L.range[i]   = p.positionMax - p.positionMin;
+            L.divisor[i] = p.gearRatio;
+            L.kp[i]      = cm.m_positionPd.kp;
+            L.kd[i]      = cm.m_positionPd.kd;
+            break;
+        case CM::ControlMode::Force:
+        case CM::ControlMode::ForceHybrid:
+            m_sources[i] = cm.m_ctrlMode == CM::ControlMode::Force ? Force : ForceHybrid;
+            L.offset[i]  = p.forceMin;
+            L.range[i]   = p.forceMax - p.forceMin;
+            L.kp[i]      = cm.m_forcePd.kp;
+            L.kd[i]      = cm.m_forcePd.kd;
+            L.kff[i]     = p.torqueMax * p.forceKff;
+            L.hasFF[i]   = 1.0;
+            break;
+        default:
+            // -0 is the additive identity, so the torque reference is exactly torqueMax * ctrl
+            m_sources[i]   = NoSource;
+            L.offset[i]    = -0.0;
+            L.range[i]     = p.torqueMax;
+            L.torqueLaw[i] = 1.0;
+            break;
+    }
+    // output filter
+    c = cm.m_outputFilter.get_coefficients();
+    L.filtOut[i] = p.filterOutputValue ? 1.0 : 0.0;
+    L.ob0[i] = c.b0; L.ob1[i] = c.b1; L.ob2[i] = c.b2; L.oa1[i] = c.a1; L.oa2[i] = c.a2;
+    // torque to volts
+    L.sign[i] = cm.m_cmdSign;
+    L.ktc[i]  = p.motorTorqueConstant;
+    L.gain[i] = p.commandGain;
+    // supervisor limits (mirror CM::velocity_limit_exceeded and CM::torque_limit_exceeded)
+    const double inf = std::numeric_limits<double>::infinity();
+    L.velMax[i]    = p.has_velocity_limit_ ? p.velocityMax : inf;
+    L.torqueMax[i] = p.has_torque_limit_ ? p.torqueMax : inf;
+    L.forceMin[i]  = cm.m_userForceMin;
+    L.forceMax[i]  = cm.m_userForceMax;
+    L.posMin[i]    = cm.m_userPositionMin;
+    L.posMax[i]    = cm.m_userPositionMax;
+    // input filters (the force and dFdt paths only run here while they are the plain lowpass)
+    m_velocityBank.set_coefficients(i, cm.m_velocityFilter.get_coefficients());
+    loadLowpass(cm.m_forceFilter, m_forceBank, m_forceBanked, i);
+    loadLowpass(cm.m_dFdtFilter, m_dFdtBank, m_dFdtBanked, i);
+    m_versions[i] = cm.m_configVersion;
+}
+
+void CMBank::loadLowpass(CM::FilterPath& path, BiquadBank& bank, std::vector<std::uint8_t>& banked, std::size_t i) {
+    LowpassStage& stage = path.chain<CM::FilterMode::Lowpass>().stage<0>();
+    bool lowpass = path.selected() == CM::FilterMode::Lowpass;
+    // the path was primed on the device when it was selected
+    if (banked[i] && !lowpass)
+        stage.set_state(bank.get_state(i));
+    else if (!banked[i] && lowpass)
+        bank.set_state(i, stage.get_state());
+    bank.set_coefficients(i, stage.get_coefficients());
+    banked[i] = lowpass;
+}
+
+void CMBank::pull(std::size_t i) {
+    CM&           cm = *m_devices[i];
+    Biquad::State s  = cm.m_ctrlFilter.get_state();
+    m_lanes.cz1[i] = s.z1; m_lanes.cz2[i] = s.z2; m_lanes.cy[i] = s.y;
+    s = cm.m_outputFilter.get_state();
+    m_lanes.oz1[i] = s.z1; m_lanes.oz2[i] = s.z2; m_lanes.oy[i] = s.y;
+    m_velocityBank.set_state(i, cm.m_velocityFilter.get_state());
+    if (m_forceBanked[i])
+        m_forceBank.set_state(i, cm.m_forceFilter.chain<CM::FilterMode::Lowpass>().stage<0>().get_state());
+    if (m_dFdtBanked[i])
+        m_dFdtBank.set_state(i, cm.m_dFdtFilter.chain<CM::FilterMode::Lowpass>().stage<0>().get_state());
+}
+
+void CMBank::push(std::size_t i) {
+    CM& cm = *m_devices[i];
+    cm.m_ctrlFilter.set_state(Biquad::State{m_lanes.cz1[i], m_lanes.cz2[i], m_lanes.cy[i]});
+    cm.m_outputFilter.set_state(Biquad::State{m_lanes.oz1[i], m_lanes.oz2[i], m_lanes.oy[i]});
+    cm.m_velocityFilter.set_state(m_velocityBank.get_state(i));
+    if (m_forceBanked[i])
+        cm.m_forceFilter.chain<CM::FilterMode::Lowpass>().stage<0>().set_state(m_forceBank.get_state(i));
+    if (m_dFdtBanked[i])
+        cm.m_dFdtFilter.chain<CM::FilterMode::Lowpass>().stage<0>().set_state(m_dFdtBank.get_state(i));
+}
+
+void CMBank::gather(std::size_t i) {
+    CM&    cm = *m_devices[i];
+    Lanes& L  = m_lanes;
+    L.ctrl[i]   = cm.m_ctrlValue;
+    L.active[i] = (cm.m_status == CM::Status::Enabled && !m_custom[i] && scheduled(i)) ? 1.0 : 0.0;
+    L.on[i]     = cm.m_status == CM::Status::Enabled ? 1.0 : 0.0;
+    L.vel[i]    = cm.getMotorVelocity();
+    L.force[i]  = cm.getForce();
+    L.pos[i]    = cm.getSpoolPosition();
+    switch (m_sources[i]) {
+        case Position:
+            L.meas[i]  = cm.getMotorPosition();
+            L.dmeas[i] = cm.getMotorVelocity();
+            break;
+        case Force:
+            L.meas[i]  = cm.getForce();
+            L.dmeas[i] = cm.getdFdt();
+            break;
+        case ForceHybrid:
+            L.meas[i]  = cm.getForce();
+            L.dmeas[i] = cm.getSpoolVelocity();
+            break;
+        default:
+            L.meas[i] = L.dmeas[i] = 0.0;
+            break;
+    }
+}
+
+void CMBank::scatter(std::size_t i) {
+    CM&    cm = *m_devices[i];
+    Lanes& L  = m_lanes;
+    cm.m_ctrlValueFiltered = L.ctrlFiltered[i];
+    if (cm.m_status != CM::Status::Enabled)
+        return;
+    if (m_tick.hold) {
+        cm.m_torque = 0;
+        cm.m_io.commandCh.set_volts(0);
+        return;
+    }
+    if (m_custom[i]) {
+        // custom controllers run scalar against the device's own output filter
+        double ctrlValueUsed = L.filtCtrl[i] != 0.0 ? L.ctrlFiltered[i] : L.ctrl[i];
+        cm.m_outputFilter.set_state(Biquad::State{L.oz1[i], L.oz2[i], L.oy[i]});
+        cm.controlUpdate(ctrlValueUsed);
+        Biquad::State s = cm.m_outputFilter.get_state();
+        L.oz1[i] = s.z1; L.oz2[i] = s.z2; L.oy[i] = s.y;
+        return;
+    }
+    // zero-order hold between outer loop ticks
+    if (!scheduled(i))
+        return;
+    cm.m_torque = L.torque[i];
+    cm.m_io.commandCh.set_volts(L.volts[i]);
+}
+
+void CMBank::kernelScalar(std::size_t begin, std::size_t end) {
+    Lanes& L = m_lanes;
+    for (std::size_t i = begin; i < end; ++i) {
+        // control value filter (always runs, as in CM::update)
+        double x  = L.ctrl[i];
+        double cy = L.cb0[i] * x + L.cz1[i];
+        L.cz1[i]  = L.cb1[i] * x - L.ca1[i] * cy + L.cz2[i];
+        L.cz2[i]  = L.cb2[i] * x - L.ca2[i] * cy;
+        L.cy[i]   = cy;
+        L.ctrlFiltered[i] = cy;
+        double u = L.filtCtrl[i] != 0.0 ? cy : x;
+        // control law
+        double ref = (L.offset[i] + u * L.range[i]) / L.divisor[i];
+        double tq  = L.kp[i] * (ref - L.meas[i]) + L.kd[i] * (0.0 - L.dmeas[i]);
+        if (L.hasFF[i] != 0.0)
+            tq += L.kff[i] * ref;
+        if (L.torqueLaw[i] != 0.0)
+            tq = ref;
+        // output filter (only advances for DOFs that drive their motor)
+        if (L.active[i] != 0.0 && L.filtOut[i] != 0.0) {
+            double y = L.ob0[i] * tq + L.oz1[i];
+            L.oz1[i] = L.ob1[i] * tq - L.oa1[i] * y + L.oz2[i];
+            L.oz2[i] = L.ob2[i] * tq - L.oa2[i] * y;
+            L.oy[i]  = y;
+            tq = y;
+        }
+        L.torque[i] = tq;
+        L.volts[i]  = tq * L.sign[i] / L.ktc[i] / L.gain[i];
+    }
+}
+
+#ifdef __AVX2__
+void CMBank::kernelAvx2(std::size_t begin, std::size_t end) {
+    Lanes&        L    = m_lanes;
+    const __m256d zero = _mm256_setzero_pd();
+    for (std::size_t i = begin; i < end; i += 4) {
+        // control value filter
+        __m256d x   = _mm256_loadu_pd(&L.ctrl[i]);
+        __m256d cy  = _mm256_add_pd(_mm256_mul_pd(_mm256_loadu_pd(&L.cb0[i]), x), _mm256_loadu_pd(&L.cz1[i]));
+        __m256d cz1 = _mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(_mm256_loadu_pd(&L.cb1[i]), x),
+                                                  _mm256_mul_pd(_mm256_loadu_pd(&L.ca1[i]), cy)),
+                                    _mm256_loadu_pd(&L.cz2[i]));
+        __m256d cz2 = _mm256_sub_pd(_mm256_mul_pd(_mm256_loadu_pd(&L.cb2[i]), x),
+                                    _mm256_mul_pd(_mm256_loadu_pd(&L.ca2[i]), cy));
+        _mm256_storeu_pd(&L.cz1[i], cz1);
+        _mm256_storeu_pd(&L.cz2[i], cz2);
+        _mm256_storeu_pd(&L.cy[i], cy);
+        _mm256_storeu_pd(&L.ctrlFiltered[i], cy);
+        __m256d u = _mm256_blendv_pd(x, cy, _mm256_cmp_pd(_mm256_loadu_pd(&L.filtCtrl[i]), zero, _CMP_NEQ_OQ));
+        // control law
+        __m256d ref = _mm256_div_pd(_mm256_add_pd(_mm256_loadu_pd(&L.offset[i]),
+                                                  _mm256_mul_pd(u, _mm256_loadu_pd(&L.range[i]))),
+                                    _mm256_loadu_pd(&L.divisor[i]));
+        __m256d e   = _mm256_sub_pd(ref, _mm256_loadu_pd(&L.meas[i]));
+        __m256d ed  = _mm256_sub_pd(zero, _mm256_loadu_pd(&L.dmeas[i]));
+        __m256d tq  = _mm256_add_pd(_mm256_mul_pd(_mm256_loadu_pd(&L.kp[i]), e),
+                                    _mm256_mul_pd(_mm256_loadu_pd(&L.kd[i]), ed));
+        __m256d ff  = _mm256_add_pd(tq, _mm256_mul_pd(_mm256_loadu_pd(&L.kff[i]), ref));
+        tq = _mm256_blendv_pd(tq, ff, _mm256_cmp_pd(_mm256_loadu_pd(&L.hasFF[i]), zero, _CMP_NEQ_OQ));
+        tq = _mm256_blendv_pd(tq, ref, _mm256_cmp_pd(_mm256_loadu_pd(&L.torqueLaw[i]), zero, _CMP_NEQ_OQ));
+        // output filter, state only advances in lanes that use it
+        __m256d filt = _mm256_and_pd(_mm256_cmp_pd(_mm256_loadu_pd(&L.active[i]), zero, _CMP_NEQ_OQ),
+                                     _mm256_cmp_pd(_mm256_loadu_pd(&L.filtOut[i]), zero, _CMP_NEQ_OQ));
+        __m256d oz1 = _mm256_loadu_pd(&L.oz1[i]);
+        __m256d oz2 = _mm256_loadu_pd(&L.oz2[i]);
+        __m256d y   = _mm256_add_pd(_mm256_mul_pd(_mm256_loadu_pd(&L.ob0[i]), tq), oz1);
+        __m256d nz1 = _mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(_mm256_loadu_pd(&L.ob1[i]), tq),
+                                                  _mm256_mul_pd(_mm256_loadu_pd(&L.oa1[i]), y)),
+                                    oz2);
+        __m256d nz2 = _mm256_sub_pd(_mm256_mul_pd(_mm256_loadu_pd(&L.ob2[i]), tq),
+                                    _mm256_mul_pd(_mm256_loadu_pd(&L.oa2[i]), y));
+        _mm256_storeu_pd(&L.oz1[i], _mm256_blendv_pd(oz1, nz1, filt));
+        _mm256_storeu_pd(&L.oz2[i], _mm256_blendv_pd(oz2, nz2, filt));
+        _mm256_storeu_pd(&L.oy[i], _mm256_blendv_pd(_mm256_loadu_pd(&L.oy[i]), y, filt));
+        tq = _mm256_blendv_pd(tq, y, filt);
+        // torque to volts
+        _mm256_storeu_pd(&L.torque[i], tq);
+        __m256d volts = _mm256_div_pd(_mm256_div_pd(_mm256_mul_pd(tq, _mm256_loadu_pd(&L.sign[i])),
+                                                    _mm256_loadu_pd(&L.ktc[i])),
+                                      _mm256_loadu_pd(&L.gain[i]));
+        _mm256_storeu_pd(&L.volts[i], volts);
+    }
+}
+#endif
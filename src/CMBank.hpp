@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "CapstanModule.hpp"
+#include "Util/BiquadBank.hpp"
+#include "Util/TimingStats.hpp"
+#include "Util/WorkerPool.hpp"
+
+/// Updates a set of CMs together. Per-DOF controller state (control value and
+/// output filter states, gains, scaling and sign flips) lives in
+/// structure-of-arrays lanes, so the control value filter, PD/feed-forward law,
+/// output filter and torque to volts conversion run for every DOF in one pass,
+/// four DOFs per instruction when built with AVX2 (see CM_AVX2 in CMakeLists).
+/// Commands, sensor reads and Queries remain per CM, and DOFs in ControlMode::Custom
+/// fall back to CM::controlUpdate. The input filters (velocity, and force and dFdt
+/// while their path is the plain lowpass) run in BiquadBanks between the sensing
+/// steps. Results match CM::update bit for bit as long as the scalar path is not
+/// compiled with floating point contraction (FMA).
+class CMBank {
+public:
+    /// Work scheduled on a tick (CMHub rate groups). Off-tick position DOFs hold
+    /// their last command and keep their output filter state.
+    struct Tick {
+        Tick(bool outer = true, bool telemetry = true, bool hold = false, bool supervise = true) :
+            outer(outer), telemetry(telemetry), hold(hold), supervise(supervise) { }
+        bool outer;      ///< run position loops
+        bool telemetry;  ///< publish Queries and fill FBuff
+        bool hold;       ///< command zero torque on every enabled DOF (CMHub safe hold)
+        bool supervise;  ///< check limits and disable violating DOFs before outputs are written
+    };
+
+    /// Constructor
+    CMBank();
+    /// Sizes the bank for a set of devices (allocates, safe to call off the control thread)
+    void assign(const std::vector<int>& ids, const std::vector<std::shared_ptr<CM>>& devices);
+    /// Loads config and takes over filter state from the devices (control thread)
+    void attach();
+    /// Hands filter state back to the devices (control thread)
+    void detach();
+    /// Updates every device in the bank, equivalent to calling CM::update on each
+    void update(const mahi::util::Time& t, Tick tick = Tick());
+    /// Same as update(t), with devices split across the pool in blocks of 8 lanes (one
+    /// cache line of doubles). Each worker runs its devices' sensing, control law and outputs.
+    void update(const mahi::util::Time& t, WorkerPool& pool, Tick tick = Tick());
+    /// Number of devices in the bank
+    std::size_t size() const;
+    /// Hub ID of DOF i
+    int id(std::size_t i) const { return m_ids[i]; }
+    /// CM::Trip bits DOF i was disabled for on the last update, 0 if none
+    int tripCause(std::size_t i) const { return m_trips[i]; }
+    /// CM::Trip bits for one DOF's motor velocity, torque command, force and spool position against
+    /// its limits, as the supervisor checks them every tick (branch free, values on a limit pass)
+    static int tripBits(double vel, double velMax, double torque, double torqueMax, double force, double forceMin,
+                        double forceMax, double pos, double posMin, double posMax) {
+        return (std::abs(vel) > velMax) * CM::Trip::VelocityLimit
+             | (std::abs(torque) > torqueMax) * CM::Trip::TorqueLimit
+             | ((force > forceMax) | (force < forceMin)) * CM::Trip::ForceLimit
+             | ((pos > posMax) | (pos < posMin)) * CM::Trip::PositionLimit;
+    }
+    /// Returns true if the lane kernel was compiled for AVX2
+    static bool simd();
+    /// Sets how the input filter banks run (BiquadBank::Validate checks the SIMD path against Biquad)
+    void setFilterMode(BiquadBank::Mode mode);
+    /// Input filter outputs that differed from Biquad in Validate mode
+    std::uint64_t filterMismatches() const;
+    /// Copies per device (commands, sensing, outputs, telemetry) timing for up to max devices and the lane kernel
+    /// timing, returns the number of devices copied (DO NOT CALL WHILE UPDATING)
+    std::size_t getTiming(int* ids, TimingStats* devices, std::size_t max, TimingStats& kernel) const;
+    /// Clears timing statistics (DO NOT CALL WHILE UPDATING)
+    void resetTiming();
+
+private:
+    /// Source of the measured value for the PD law
+    enum Source : int {
+        NoSource    = 0,  ///< torque mode (no feedback)
+        Position    = 1,  ///< motor position and velocity
+        Force       = 2,  ///< filtered force and dFdt
+        ForceHybrid = 3   ///< filtered force and spool velocity
+    };
+
+    /// Per-DOF lanes, padded to a multiple of 4
+    struct Lanes {
+        void resize(std::size_t n);
+        // per tick inputs
+        std::vector<double> ctrl, meas, dmeas, active;
+        // control value filter
+        std::vector<double> filtCtrl, cb0, cb1, cb2, ca1, ca2, cz1, cz2, cy;
+        // control law: ref = (offset + ctrl * range) / divisor, torque = kp e + kd ed (+ kff ref)
+        std::vector<double> offset, range, divisor, kp, kd, kff, hasFF, torqueLaw;
+        // output filter
+        std::vector<double> filtOut, ob0, ob1, ob2, oa1, oa2, oz1, oz2, oy;
+        // torque to volts
+        std::vector<double> sign, ktc, gain;
+        // per tick outputs
+        std::vector<double> ctrlFiltered, torque, volts;
+        // supervisor inputs and limits (infinite when a limit is off)
+        std::vector<double> on, vel, force, pos, cmd;
+        std::vector<double> velMax, torqueMax, forceMin, forceMax, posMin, posMax;
+    };
+
+    /// WorkerPool task: updates the block range of one part
+    static void updatePart(void* bank, int part, int parts);
+    /// Updates DOFs [begin, end), begin a multiple of 4
+    void updateRange(const mahi::util::Time& t, std::size_t begin, std::size_t end);
+    /// Refreshes the configuration lanes of DOF i from its device
+    void load(std::size_t i);
+    /// Copies filter state between DOF i and its device's Biquads
+    void pull(std::size_t i);
+    void push(std::size_t i);
+    /// Hands a force or dFdt lowpass between the device and a bank when DOF i's filter path changes
+    static void loadLowpass(CM::FilterPath& path, BiquadBank& bank, std::vector<std::uint8_t>& banked, std::size_t i);
+    /// Reads sensors and runs the input filters of DOFs [begin, end)
+    void sense(const mahi::util::Time& t, std::size_t begin, std::size_t end);
+    /// Gathers per tick inputs of DOF i
+    void gather(std::size_t i);
+    /// Applies per tick outputs of DOF i
+    void scatter(std::size_t i);
+    /// True if DOF i runs its control law this tick
+    bool scheduled(std::size_t i) const { return !m_tick.hold && (m_tick.outer || m_sources[i] != Position); }
+    /// Checks DOFs [begin, end) against their limits and sets m_trips (no branches per limit)
+    void supervise(std::size_t begin, std::size_t end);
+    /// Runs the lane kernel over [begin, end)
+    void kernelScalar(std::size_t begin, std::size_t end);
+    /// Runs the lane kernel over [begin, end) with AVX2 (defined only when CMBank.cpp is built for AVX2)
+    void kernelAvx2(std::size_t begin, std::size_t end);
+
+private:
+    std::vector<std::shared_ptr<CM>> m_devices;   ///< banked devices
+    std::vector<int>                 m_ids;       ///< hub ID per DOF
+    std::vector<std::uint64_t>       m_versions;  ///< CM::m_configVersion last loaded per DOF
+    std::vector<int>                 m_sources;   ///< Source per DOF
+    std::vector<std::uint8_t>        m_custom;    ///< DOF is in ControlMode::Custom (bytes, so workers can write neighbours)
+    std::vector<int>                 m_trips;     ///< CM::Trip bits per DOF from the last update
+    Lanes                            m_lanes;
+    BiquadBank                       m_velocityBank;  ///< software velocity filter per DOF
+    BiquadBank                       m_forceBank;     ///< force lowpass per DOF
+    BiquadBank                       m_dFdtBank;      ///< dFdt lowpass per DOF
+    std::vector<std::uint8_t>        m_forceBanked;   ///< force path is the plain lowpass (filtered by m_forceBank)
+    std::vector<std::uint8_t>        m_dFdtBanked;    ///< dFdt path is the plain lowpass (filtered by m_dFdtBank)
+    std::vector<TimingStats>         m_timing;    ///< per DOF time outside the lane kernel
+    std::vector<std::chrono::steady_clock::duration> m_phase;  ///< per DOF time spent before the kernel this tick
+    TimingStats                      m_kernelTiming;
+    mahi::util::Time                 m_tickTime;  ///< time of the tick being run by updatePart
+    Tick                             m_tick;      ///< work scheduled on the tick being run
+};
@@ -51,6 +51,8 @@ inline bool ShowParamsMenu(CM::Params &p)
         changed = true;
     if (ImGui::DragInt("Force Filter Samples", &p.forceFilterN, 1, 3, 1000))
         changed = true;
+    if (ImGui::DragInt("Force Average Samples", &p.forceFilterAvgN, 1, 1, 1000))
+        changed = true;
     if (ImGui::DragDouble("CV Filter Cutoff Wn", &p.cvFilterCutoff, 0.001f, 0, 1))
         changed = true;
     if (ImGui::Checkbox("Filter Control Value", &p.filterControlValue))
@@ -71,6 +73,16 @@ inline bool ShowParamsMenu(CM::Params &p)
     return changed;
 }
 
+inline void ShowLatency(const char* label, const LatencyStats &s) {
+    ImGui::PushID(label);
+    ImGui::LabelText(label, "p50 %.0f / p99 %.0f / p99.9 %.0f / max %.0f us", s.p50, s.p99, s.p999, s.max);
+    float bins[LatencyStats::Bins];
+    for (int i = 0; i < LatencyStats::Bins; ++i)
+        bins[i] = (float)s.bins[i];
+    ImGui::PlotHistogram("##Histogram", bins, LatencyStats::Bins, 0, "log2 us", 0.0f, FLT_MAX, ImVec2(0, 60));
+    ImGui::PopID();
+}
+
 inline void ShowHubQuery(const CMHub::Query &Q) {
     ImGui::LabelText("Status", Q.status == CMHub::Idle ? "Idle" : Q.status == CMHub::Running ? "Running" : Q.status == CMHub::Error ? "Error" : "?");
     ImGui::LabelText("Devices", "%d", Q.devices);
@@ -79,8 +91,23 @@ inline void ShowHubQuery(const CMHub::Query &Q) {
     ImGui::LabelText("Misses", "%d", Q.misses);
     ImGui::LabelText("Miss Rate", "%.3f", Q.missRate);
     ImGui::LabelText("Wait Ratio", "%.3f", Q.waitRatio);
+    ImGui::LabelText("Sleep Ratio", "%.3f", Q.sleepRatio);
+    ImGui::LabelText("Timer Margin", "%.0f us", Q.timerMargin);
     ImGui::LabelText("Lock Count", "%d", Q.lockCount);
     ImGui::LabelText("Loop Rate", "%.3f Hz", Q.loopRate);
+    ImGui::LabelText("Query Retries", "%d", Q.queryRetries);
+    ImGui::LabelText("RT Priority", "%d", Q.rt.priority);
+    ImGui::LabelText("RT CPU", "%d", Q.rt.cpu);
+    ImGui::LabelText("RT Memory", "%s%s", Q.rt.memoryLocked ? "Locked" : "Unlocked", Q.rt.prefaulted ? ", Prefaulted" : "");
+    ImGui::LabelText("Workers", "%d", Q.workers);
+    ImGui::LabelText("Position Rate", "%.0f Hz", Q.outerRate);
+    ImGui::LabelText("Telemetry Rate", "%.0f Hz", Q.telemetryRate);
+    ImGui::LabelText("Overrun Mode", Q.overrunMode == CMHub::Nominal ? "Nominal" : Q.overrunMode == CMHub::Shedding ? "Shedding" : Q.overrunMode == CMHub::Holding ? "Holding" : Q.overrunMode == CMHub::Disabled ? "Disabled" : "?");
+    ImGui::LabelText("Overruns", "%d", Q.overruns);
+    ImGui::LabelText("Log Dropped", "%d", Q.logDropped);
+    ShowLatency("Tick Period", Q.tickPeriod);
+    ShowLatency("Wake Lateness", Q.wakeLateness);
+    ShowLatency("Compute Time", Q.computeTime);
 }
 
 inline void ShowCMQuerey(CM::Query &q)
@@ -101,6 +128,11 @@ inline void ShowCMQuerey(CM::Query &q)
     ImGui::LabelText("Control Value (Scaled)", "%.3f", q.ctrlValueScaled);
     ImGui::LabelText("Lock Count", "%d", q.lockCount);
     ImGui::LabelText("Feed Rate", "%.3f Hz", q.feedRate);
+    ImGui::LabelText("Feed Interval", "%.2f ms (max %.2f ms)", q.feedInterval, q.feedIntervalMax);
+    ImGui::LabelText("Feed Jitter", "%.3f ms", q.feedJitter);
+    ImGui::LabelText("Feed Starved", "%.1f %%", 100.0 * q.feedStarved);
+    ImGui::LabelText("Trip Cause", "%s", CM::tripName(q.tripCause));
+    ImGui::LabelText("Query Retries", "%d", q.queryRetries);
 }
 
 }; // namespace CMGui
\ No newline at end of file
@@ -2,6 +2,9 @@
 #include <Mahi/Util.hpp>
 #include <Mahi/Robo.hpp>
 #include "Util/ATI_windowCal.hpp"
+#include "Util/AsyncLog.hpp"
+#include <algorithm>
+#include <chrono>
 
 // Written by Janelle Clark, based off code by Evan Pezent
 
@@ -9,35 +12,124 @@ using namespace mahi::daq;
 using namespace mahi::util;
 using namespace mahi::robo;
 
+namespace {
+    AsyncLog::Format OverrunDisableLog(Error, "CM Hub overran {} consecutive ticks. Disabling CM(s).", 0.0);
+}
+
 #define CM_THREAD_SAFE
 #ifdef CM_THREAD_SAFE
 #define CM_DAQ_LOCK std::lock_guard<std::mutex> lock(m_mutex); m_lockCount++;
 #else
 #define CM_DAQ_LOCK
 #endif
+// serializes device table writers and readers (never taken by the control thread)
+#define CM_REGISTRY_LOCK std::lock_guard<std::mutex> registryLock(m_registryMutex);
 
-CMHub::CMHub(int Fs) :
+CMHub::CMHub(int Fs, bool simulated) :
+#ifdef CM_Q8
     daq(false),
+    m_simulated(simulated),
+#else
+    m_simulated(true),
+#endif
     m_status(Status::Idle),
-    m_timer(hertz(Fs), Timer::WaitMode::Busy),
+    m_timer(hertz(Fs), HybridTimer::Busy),
     m_lockCount(0),
     m_running(false),
-    m_loopRate(seconds(0.5))
+    m_table(new DeviceTable),
+    m_current(nullptr),
+    m_epoch(0),
+    m_threadActive(false),
+    m_deviceCount(0),
+    m_loopRate(seconds(0.5)),
+    m_timingReset(false),
+    m_statsCountdown(0),
+    m_workers(1),
+    m_outerDivider(1),
+    m_telemetryDivider(1),
+    m_supervise(true),
+    m_overrunMode(OverrunMode::Nominal),
+    m_overruns(0),
+    m_onTime(0),
+    m_missesSeen(0),
+    m_events(256)
 { 
+    m_timer.set_skip_missed(true);
+#ifndef CM_Q8
+    if (!simulated)
+        LOG(Warning) << "Built without CM_Q8, CMHub runs on the simulator.";
+#endif
     LOG(Info) << "CMHub created.";
 }
 
 CMHub::~CMHub() {
     if (m_running)
         stop();    
+    if (m_current)
+        m_current->bank.detach();
+    delete m_table.load();
+}
+
+std::shared_ptr<CM> CMHub::DeviceTable::find(int id) const {
+    auto it = std::lower_bound(ids.begin(), ids.end(), id);
+    if (it == ids.end() || *it != id)
+        return nullptr;
+    return devices[it - ids.begin()];
+}
+
+std::map<int, std::shared_ptr<CM>> CMHub::deviceMap() const {
+    const DeviceTable* table = m_table.load(std::memory_order_acquire);
+    std::map<int, std::shared_ptr<CM>> devices;
+    for (std::size_t i = 0; i < table->ids.size(); ++i)
+        devices.emplace(table->ids[i], table->devices[i]);
+    return devices;
+}
+
+void CMHub::publishTable(const std::map<int, std::shared_ptr<CM>>& devices) {
+    // everything that allocates happens here, off the control thread
+    DeviceTable* table = new DeviceTable;
+    for (auto& device : devices) {
+        table->ids.push_back(device.first);
+        table->devices.push_back(device.second);
+    }
+    table->bank.assign(table->ids, table->devices);
+    DeviceTable* old = m_table.exchange(table, std::memory_order_acq_rel);
+    m_deviceCount = (int)devices.size();
+    // grace period: two completed ticks guarantee the control thread has adopted the new table
+    std::uint64_t epoch = m_epoch.load(std::memory_order_acquire);
+    while (m_threadActive.load(std::memory_order_acquire) && m_epoch.load(std::memory_order_acquire) < epoch + 2)
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    if (!m_threadActive.load(std::memory_order_acquire)) {
+        CM_DAQ_LOCK
+        adoptTable();
+    }
+    delete old;
+}
+
+void CMHub::adoptTable() {
+    DeviceTable* table = m_table.load(std::memory_order_acquire);
+    if (table == m_current)
+        return;
+    if (m_current)
+        m_current->bank.detach();
+    table->bank.attach();
+    m_current = table;
 }
 
 int CMHub::createDevice(int id, int enable, int fault, int command, int encoder, int force, std::vector<double> forceCal) {
-    CM_DAQ_LOCK
-    if (m_devices.count(id)) {
-        LOG(Info) << "CM " << m_devices[id]->name() << " already initialized.";
+    CM_REGISTRY_LOCK
+    auto devices = deviceMap();
+    if (devices.count(id)) {
+        LOG(Info) << "CM " << devices[id]->name() << " already initialized.";
         return ErrorCode::InvalidID;
     }
+    else if (m_simulated) {
+        std::shared_ptr<CM> cm = createSimDevice(id, enable, fault, command, encoder, force, Axis::AxisX);
+        if (!cm)
+            return ErrorCode::AlreadyRunning;
+        devices[id] = cm;
+    }
+#ifdef CM_Q8
     else {
         AIForceSensor* aisensor = new AIForceSensor();
         aisensor->set_force_calibration(forceCal[0], forceCal[1], forceCal[2]);
@@ -54,17 +146,28 @@ int CMHub::createDevice(int id, int enable, int fault, int command, int encoder,
             &daq.velocity[encoder],
             &daq.velocity.velocities[encoder]
         };
-        m_devices[id] = std::make_shared<CM>( "cm_" + std::to_string(id), io, CM::Params());
+        devices[id] = std::make_shared<CM>( "cm_" + std::to_string(id), io, CM::Params());
     }
+#endif
+    publishTable(devices);
     return ErrorCode::NoError;
 }
 
 int CMHub::createDevice(int id, int enable, int fault, int command, int encoder, Axis forceAxis, const std::string& filepath, std::vector<int> ati_chan, bool windowCal) {
-    CM_DAQ_LOCK
-    if (m_devices.count(id)) {
-        LOG(Info) << "CM " << m_devices[id]->name() << " already initialized.";
+    CM_REGISTRY_LOCK
+    auto devices = deviceMap();
+    if (devices.count(id)) {
+        LOG(Info) << "CM " << devices[id]->name() << " already initialized.";
         return ErrorCode::InvalidID;
-    } else if (windowCal == 0){
+    } else if (m_simulated) {
+        // the transducer is modelled as a single-axis sensor on the channel of forceAxis
+        std::shared_ptr<CM> cm = createSimDevice(id, enable, fault, command, encoder, ati_chan[(int)forceAxis], forceAxis);
+        if (!cm)
+            return ErrorCode::AlreadyRunning;
+        devices[id] = cm;
+    }
+#ifdef CM_Q8
+    else if (windowCal == 0){
         AtiSensor* ati = new AtiSensor();
         ati->set_channels(&daq.AI[ati_chan[0]], &daq.AI[ati_chan[1]], &daq.AI[ati_chan[2]], &daq.AI[ati_chan[3]], &daq.AI[ati_chan[4]], &daq.AI[ati_chan[5]]);
         ati->load_calibration(filepath);
@@ -81,7 +184,7 @@ int CMHub::createDevice(int id, int enable, int fault, int command, int encoder,
             &daq.velocity.velocities[encoder]
         };
 
-        m_devices[id] = std::make_shared<CM>( "cm_" + std::to_string(id), io, CM::Params());
+        devices[id] = std::make_shared<CM>( "cm_" + std::to_string(id), io, CM::Params());
      }else if (windowCal == 1) {
         AtiWindowCal* wAti = new AtiWindowCal();
         wAti->set_channels(&daq.AI[ati_chan[0]], &daq.AI[ati_chan[1]], &daq.AI[ati_chan[2]], &daq.AI[ati_chan[3]], &daq.AI[ati_chan[4]], &daq.AI[ati_chan[5]]);
@@ -99,37 +202,124 @@ int CMHub::createDevice(int id, int enable, int fault, int command, int encoder,
             &daq.velocity.velocities[encoder]
         };
 
-        m_devices[id] = std::make_shared<CM>( "cm_" + std::to_string(id), io, CM::Params());
+        devices[id] = std::make_shared<CM>( "cm_" + std::to_string(id), io, CM::Params());
     }
+#endif
+    publishTable(devices);
     return ErrorCode::NoError;
 }
 
 
+std::shared_ptr<CM> CMHub::createSimDevice(int id, int enable, int fault, int command, int encoder, int force, Axis forceAxis) {
+    // the control thread steps the plants without locking, so they can only be added while it is stopped
+    if (m_threadActive) {
+        LOG(Error) << "CM Hub running. Simulated devices must be created before start().";
+        return nullptr;
+    }
+    CM::Params params;
+    // the normal DOF is wired like the rig in calibs/CM/dof_normal.json, the others like dof_tangential.json
+    SimDaq::Wiring wiring = forceAxis == Axis::AxisZ ? SimDaq::Wiring::normal() : SimDaq::Wiring::tangential();
+    wiring.enable  = enable;
+    wiring.fault   = fault;
+    wiring.command = command;
+    wiring.encoder = encoder;
+    wiring.force   = force;
+    CapstanPlant::Params plant;
+    plant.torqueConstant = params.motorTorqueConstant;
+    plant.commandGain    = params.commandGain;
+    plant.gearRatio      = params.gearRatio;
+    plant.degPerCount    = params.degPerCount;
+    plant.tangential     = forceAxis != Axis::AxisZ;
+    sim.addPlant(wiring, plant);
+    SimForceSensor* sensor = new SimForceSensor(&sim.AI[force], wiring.forceGain);
+
+    CM::Io io = {
+        DOHandle(sim.DO,enable),
+        DIHandle(sim.DI,fault),
+        AOHandle(sim.AO,command),
+        EncoderHandle(sim.encoder,encoder),
+        *sensor,
+        forceAxis,
+        &sim.velocity[encoder],
+        &sim.velocity.velocities[encoder]
+    };
+    return std::make_shared<CM>( "cm_" + std::to_string(id), io, params);
+}
+
 int CMHub::addDevice(int id, std::shared_ptr<CM> cm) {
-    CM_DAQ_LOCK
-    if (m_devices.count(id)) {
-        LOG(Info) << "CM " << m_devices[id]->name() << " already initialized.";
+    CM_REGISTRY_LOCK
+    auto devices = deviceMap();
+    if (devices.count(id)) {
+        LOG(Info) << "CM " << devices[id]->name() << " already initialized.";
         return ErrorCode::InvalidID;
     }
     else {
-        m_devices.emplace(id, std::move(cm));
+        devices.emplace(id, std::move(cm));
+        publishTable(devices);
     }
     return ErrorCode::NoError;
 }
 
 int CMHub::destroyDevice(int id) {
-    CM_DAQ_LOCK
-    if (m_devices.count(id) == 0) { 
+    CM_REGISTRY_LOCK
+    auto devices = deviceMap();
+    if (devices.count(id) == 0) { 
         LOG(mahi::util::Error) << "CM ID " << id << " invalid."; 
         return ErrorCode::InvalidID;
     }
-    m_devices.erase(id);
+    devices.erase(id);
+    publishTable(devices);
     return ErrorCode::NoError;
 }
 
 void CMHub::setSampleRate(int Fs) {
     CM_DAQ_LOCK
-    m_timer = Timer(hertz(Fs), Timer::WaitMode::Busy);
+    m_timer = HybridTimer(hertz(Fs), m_timer.get_wait_mode());
+    m_timer.set_skip_missed(true);
+}
+
+void CMHub::setRateGroups(int outerDivider, int telemetryDivider) {
+    CM_DAQ_LOCK
+    m_outerDivider = std::max(outerDivider, 1);
+    m_telemetryDivider = std::max(telemetryDivider, 1);
+}
+
+void CMHub::setWaitMode(HybridTimer::WaitMode mode) {
+    CM_DAQ_LOCK
+    m_timer = HybridTimer(m_timer.get_period(), mode);
+    m_timer.set_skip_missed(true);
+}
+
+void CMHub::setOverrunPolicy(const OverrunConfig& config) {
+    CM_DAQ_LOCK
+    m_overrun = config;
+    m_overrun.holdAfter = std::max(m_overrun.holdAfter, 1);
+    m_overrun.disableAfter = std::max(m_overrun.disableAfter, m_overrun.holdAfter);
+    m_overrun.recoverAfter = std::max(m_overrun.recoverAfter, 1);
+}
+
+void CMHub::setSupervisor(bool enable) {
+    CM_DAQ_LOCK
+    m_supervise = enable;
+}
+
+std::size_t CMHub::readEvents(std::uint64_t& cursor, std::vector<Event>& events) const {
+    return m_events.read_since(cursor, events);
+}
+
+void CMHub::setRtConfig(const RtConfig& config) {
+    CM_DAQ_LOCK
+    m_rtConfig = config;
+    if (m_running)
+        LOG(Warning) << "CM Hub running. Real-time settings will apply on the next start.";
+}
+
+void CMHub::setWorkers(int workers, const std::vector<int>& cpus) {
+    CM_DAQ_LOCK
+    m_workers = std::max(workers, 1);
+    m_workerCpus = cpus;
+    if (m_running)
+        LOG(Warning) << "CM Hub running. Worker settings will apply on the next start.";
 }
 
 int CMHub::start(bool soft) {
@@ -137,10 +327,18 @@ int CMHub::start(bool soft) {
         LOG(Warning) << "CM Hub already running";
         return ErrorCode::AlreadyRunning;
     }
-    if (!soft) {
+    if (!soft && m_simulated) {
+        if (!sim.open() || !sim.enable()) {
+            m_status = Status::Error;
+            publishQuery();
+            return ErrorCode::DaqOpenFailed;
+        }
+    }
+#ifdef CM_Q8
+    else if (!soft) {
         if (!daq.open()) {
             m_status = Status::Error;
-            fillQuery(m_q);
+            publishQuery();
             return ErrorCode::DaqOpenFailed;
         }
         auto opts = daq.get_options();
@@ -151,12 +349,17 @@ int CMHub::start(bool soft) {
 
         if (!daq.enable()) {        
             m_status = Status::Error;
-            fillQuery(m_q);
+            publishQuery();
             return ErrorCode::DaqEnableFailed; 
         }   
     }
+#endif
     m_status = Status::Running;
     m_running = true;
+    {
+        CM_REGISTRY_LOCK
+        m_threadActive = true;
+    }
     m_controlThread = std::thread(&CMHub::controlThreadFunction, this, soft);
     return ErrorCode::NoError;
 }
@@ -177,6 +380,23 @@ int CMHub::stop() {
 
 void CMHub::controlThreadFunction(bool soft) {
     LOG(Info) << "CM Hub started";
+    {
+        CM_DAQ_LOCK
+        m_rtStatus = applyRealTime(m_rtConfig);
+        if (m_workers > 1) {
+            // part 0 is this thread, which keeps the pinning from m_rtConfig
+            std::vector<int> cpus = {m_rtConfig.cpu};
+            cpus.insert(cpus.end(), m_workerCpus.begin(), m_workerCpus.end());
+            m_pool.reset(new WorkerPool(m_workers, m_rtConfig, cpus));
+        }
+        m_periodHist.reset();
+        m_latenessHist.reset();
+        m_computeHist.reset();
+        m_overrunMode = OverrunMode::Nominal;
+        m_overruns = 0;
+        m_onTime = 0;
+        m_missesSeen = 0;
+    }
     m_timer.restart();
     if (soft) {
         while (m_running) {
@@ -196,88 +416,321 @@ void CMHub::controlThreadFunction(bool soft) {
     }
     // shutdown devices
     LOG(Info) << "Disabling CM(s) ...";
-    for (auto& device : m_devices) {
-        if (device.second->is_enabled())
-            device.second->disable();
+    {
+        CM_DAQ_LOCK
+        adoptTable();
+        for (auto& device : m_current->devices) {
+            if (device->is_enabled())
+                device->disable();
+        }
     }
     // shutdown DAQ
     LOG(Info) << "Disabling and closing DAQ ...";
-    if (!soft) {
+    if (!soft && m_simulated) {
+        if (sim.is_enabled())
+            sim.disable();
+        if (sim.is_open())
+            sim.close();
+    }
+#ifdef CM_Q8
+    else if (!soft) {
         if (daq.is_enabled())
             daq.disable();
         if (daq.is_open())
             daq.close();
     }
-    fillQuery(m_q);
+#endif
+    {
+        CM_DAQ_LOCK
+        m_pool.reset();
+    }
+    publishQuery();
+    // from here on device table writers hand bank state over themselves
+    m_threadActive = false;
+}
+
+bool CMHub::readAll() {
+#ifdef CM_Q8
+    if (!m_simulated)
+        return daq.read_all();
+#endif
+    return sim.read_all();
+}
+
+bool CMHub::writeAll() {
+#ifdef CM_Q8
+    if (!m_simulated)
+        return daq.write_all();
+#endif
+    return sim.write_all();
 }
 
 bool CMHub::update() {
     CM_DAQ_LOCK
+    CM_TIMING_BEGIN(tick)
     Time t = m_timer.get_elapsed_time();
+    recordTickStart(t);
+    adoptTable();
+    if (m_timingReset.exchange(false, std::memory_order_acquire)) {
+        m_timing = TimingSnapshot();
+        m_current->bank.resetTiming();
+    }
+    handleOverrun();
+    CMBank::Tick work = scheduleTick();
     // update inputs
-    if (!daq.read_all())
+    CM_TIMING_BEGIN(read)
+    if (m_simulated)
+        sim.step(t);
+    if (!readAll())
         return false;
+    CM_TIMING_END(read, m_timing.read)
     // update devices
-    for (auto& device : m_devices)
-        device.second->update(t);
+    CM_TIMING_BEGIN(devices)
+    if (m_pool)
+        m_current->bank.update(t, *m_pool, work);
+    else
+        m_current->bank.update(t, work);
+    recordTrips();
+    CM_TIMING_END(devices, m_timing.devices)
     // update ouputs
-    if (!daq.write_all())
+    CM_TIMING_BEGIN(write)
+    if (!writeAll())
         return false;
+    CM_TIMING_END(write, m_timing.write)
     // update query info
     m_loopRate.tick();
     m_loopRate.update(t);
-    fillQuery(m_q);
+    recordTickEnd(t);
+    CM_TIMING_END(tick, m_timing.tick)
+    if (telemetryTick())
+        publishQuery();
     m_lockCount = 0;
+    // quiescent point: this tick no longer references any older device table
+    m_epoch.fetch_add(1, std::memory_order_release);
     return true;
 }
 
 bool CMHub::updateSoft() {
     CM_DAQ_LOCK
+    CM_TIMING_BEGIN(tick)
     Time t = m_timer.get_elapsed_time();
+    recordTickStart(t);
+    adoptTable();
+    if (m_timingReset.exchange(false, std::memory_order_acquire)) {
+        m_timing = TimingSnapshot();
+        m_current->bank.resetTiming();
+    }
+    handleOverrun();
+    CMBank::Tick work = scheduleTick();
     // update devices
-    for (auto& device : m_devices)
-        device.second->update(t);
+    CM_TIMING_BEGIN(devices)
+    if (m_pool)
+        m_current->bank.update(t, *m_pool, work);
+    else
+        m_current->bank.update(t, work);
+    recordTrips();
+    CM_TIMING_END(devices, m_timing.devices)
     // update query info
     m_loopRate.tick();
     m_loopRate.update(t);
-    fillQuery(m_q);
+    recordTickEnd(t);
+    CM_TIMING_END(tick, m_timing.tick)
+    if (telemetryTick())
+        publishQuery();
     m_lockCount = 0;
+    // quiescent point: this tick no longer references any older device table
+    m_epoch.fetch_add(1, std::memory_order_release);
     return true;
 }
 
 bool CMHub::validateDeviceId(int id) {
-    CM_DAQ_LOCK
-    if (m_devices.count(id))
+    CM_REGISTRY_LOCK
+    if (m_table.load(std::memory_order_acquire)->find(id))
         return true;
     return false;
 }
 
 std::shared_ptr<CM> CMHub::getDevice(int id) {
-    CM_DAQ_LOCK
-    if (m_devices.count(id)) 
-        return m_devices[id];
+    CM_REGISTRY_LOCK
+    if (auto device = m_table.load(std::memory_order_acquire)->find(id))
+        return device;
     LOG(mahi::util::Error) << "CM ID " << id << " invalid.";
     return nullptr;
 }
 
+CMHub::TimingReport CMHub::getTimingReport(bool reset) {
+    TimingSnapshot snapshot = m_timingPublished.load();
+    if (reset)
+        m_timingReset.store(true, std::memory_order_release);
+    TimingReport report;
+    report.read    = snapshot.read;
+    report.devices = snapshot.devices;
+    report.kernel  = snapshot.kernel;
+    report.write   = snapshot.write;
+    report.tick    = snapshot.tick;
+    for (int i = 0; i < snapshot.deviceCount; ++i)
+        report.device[snapshot.ids[i]] = snapshot.device[i];
+    return report;
+}
+
 CMHub::Query CMHub::getQuery(bool immediate) {
-    CM_DAQ_LOCK
     if (immediate) {
+        CM_DAQ_LOCK
         Query q;
         fillQuery(q);
         return q;
     }
-    return m_q;
+    return m_qPublished.load();
 }
 
 void CMHub::fillQuery(Query& q) {
-    q.devices = (int)m_devices.size();
+    q.devices = m_deviceCount;
     q.status = m_status;
     q.time = m_timer.get_elapsed_time_ideal().as_seconds();
     q.tick = (int)m_timer.get_elapsed_ticks();
     q.misses = (int)m_timer.get_misses();
     q.missRate = m_timer.get_miss_rate();
     q.waitRatio = m_timer.get_wait_ratio();
+    q.sleepRatio = m_timer.get_sleep_ratio();
+    q.timerMargin = m_timer.get_margin().as_microseconds();
     q.lockCount = m_lockCount;
     q.loopRate = m_loopRate.rate();
+    q.queryRetries = (int)m_qPublished.retries();
+    q.rt = m_rtStatus;
+    q.workers = m_pool ? m_pool->size() : 1;
+    double rate = 1.0 / m_timer.get_period().as_seconds();
+    q.outerRate = rate / m_outerDivider;
+    q.telemetryRate = rate / m_telemetryDivider;
+    q.overrunMode = m_overrunMode;
+    q.overruns = m_overruns;
+    q.logDropped = (int)AsyncLog::get().stats().dropped;
+    q.tickPeriod = m_periodStats;
+    q.wakeLateness = m_latenessStats;
+    q.computeTime = m_computeStats;
+}
+
+void CMHub::recordTickStart(const Time& t) {
+    if (m_timer.get_elapsed_ticks() > 0) {
+        m_periodHist.record((t - m_lastTick).as_microseconds());
+        m_latenessHist.record((t - m_timer.get_elapsed_time_ideal()).as_microseconds());
+    }
+    m_lastTick = t;
+}
+
+void CMHub::recordTickEnd(const Time& t) {
+    m_computeHist.record((m_timer.get_elapsed_time() - t).as_microseconds());
+    // percentiles scan every bucket, so only refresh them every 100 ticks
+    if (--m_statsCountdown <= 0) {
+        m_periodHist.summarize(m_periodStats);
+        m_latenessHist.summarize(m_latenessStats);
+        m_computeHist.summarize(m_computeStats);
+        m_statsCountdown = 100;
+    }
+}
+
+bool CMHub::telemetryTick() const {
+    return m_timer.get_elapsed_ticks() % m_telemetryDivider == 0;
+}
+
+CMBank::Tick CMHub::scheduleTick() const {
+    std::int64_t tick = m_timer.get_elapsed_ticks();
+    CMBank::Tick work;
+    work.outer     = tick % m_outerDivider == 0;
+    // the hub Query is cheap and keeps being published, only device telemetry is shed
+    work.telemetry = telemetryTick() && m_overrunMode == OverrunMode::Nominal;
+    work.hold      = m_overrunMode == OverrunMode::Holding;
+    work.supervise = m_supervise;
+    return work;
+}
+
+void CMHub::handleOverrun() {
+    std::int64_t misses = m_timer.get_misses();
+    std::int64_t missed = misses - m_missesSeen;
+    m_missesSeen = misses;
+    if (missed > 0) {
+        m_overruns++;
+        m_onTime = 0;
+        Event e;
+        e.type = Event::Overrun;
+        e.tick = m_timer.get_elapsed_ticks();
+        e.time = m_timer.get_elapsed_time().as_seconds();
+        e.missed = (int)missed;
+        e.consecutive = m_overruns;
+        e.from = e.to = m_overrunMode;
+        m_events.push_back(e);
+    }
+    else {
+        m_overruns = 0;
+        m_onTime++;
+    }
+    OverrunMode mode = nextOverrunMode(m_overrun, m_overrunMode, missed, m_overruns, m_onTime);
+    if (mode != m_overrunMode)
+        setOverrunMode(mode, missed);
+}
+
+CMHub::OverrunMode CMHub::nextOverrunMode(const OverrunConfig& config, OverrunMode mode, std::int64_t missed, int overruns, int onTime) {
+    if (missed > 0 && config.policy != OverrunPolicy::CatchUp) {
+        if (mode == OverrunMode::Nominal)
+            mode = OverrunMode::Shedding;
+        if (config.policy == OverrunPolicy::SafeHold) {
+            if (overruns >= config.disableAfter)
+                mode = OverrunMode::Disabled;
+            else if (overruns >= config.holdAfter && mode < OverrunMode::Holding)
+                mode = OverrunMode::Holding;
+        }
+    }
+    else if (mode != OverrunMode::Nominal && (onTime >= config.recoverAfter || config.policy == OverrunPolicy::CatchUp)) {
+        // devices disabled by SafeHold stay disabled until re-enabled
+        mode = OverrunMode::Nominal;
+    }
+    return mode;
+}
+
+void CMHub::setOverrunMode(OverrunMode mode, std::int64_t missed) {
+    Event e;
+    e.type = Event::ModeChange;
+    e.tick = m_timer.get_elapsed_ticks();
+    e.time = m_timer.get_elapsed_time().as_seconds();
+    e.missed = (int)std::max(missed, std::int64_t(0));
+    e.consecutive = m_overruns;
+    e.from = m_overrunMode;
+    e.to = mode;
+    m_events.push_back(e);
+    m_overrunMode = mode;
+    if (mode == OverrunMode::Disabled) {
+        AsyncLog::get().log(OverrunDisableLog, m_overruns);
+        for (auto& device : m_current->devices) {
+            if (device->is_enabled())
+                device->disable();
+        }
+    }
+}
+
+void CMHub::recordTrips() {
+    const CMBank& bank = m_current->bank;
+    for (std::size_t i = 0; i < bank.size(); ++i) {
+        if (int cause = bank.tripCause(i)) {
+            Event e;
+            e.type = Event::SafetyTrip;
+            e.tick = m_timer.get_elapsed_ticks();
+            e.time = m_timer.get_elapsed_time().as_seconds();
+            e.from = e.to = m_overrunMode;
+            e.device = bank.id(i);
+            e.cause = cause;
+            m_events.push_back(e);
+        }
+    }
+}
+
+void CMHub::publishQuery() {
+    fillQuery(m_q);
+    m_qPublished.store(m_q);
+    publishTiming();
+}
+
+void CMHub::publishTiming() {
+#ifdef CM_TIMING
+    m_timing.deviceCount = m_current ? (int)m_current->bank.getTiming(m_timing.ids, m_timing.device, TimingSnapshot::MaxDevices, m_timing.kernel) : 0;
+    m_timingPublished.store(m_timing);
+#endif
 }
\ No newline at end of file
@@ -1,12 +1,21 @@
 #pragma once
 
 #include <Mahi/Daq.hpp>
+#include <atomic>
 #include <thread>
 #include <map>
 #include <memory>
 #include <mutex>
 #include "CapstanModule.hpp"
+#include "CMBank.hpp"
 #include "Util/ForceTorqueCentroid.hpp"
+#include "Util/HybridTimer.hpp"
+#include "Util/LatencyHistogram.hpp"
+#include "Util/RealTime.hpp"
+#include "Util/Seqlock.hpp"
+#include "Util/SimDaq.hpp"
+#include "Util/TelemetryRing.hpp"
+#include "Util/WorkerPool.hpp"
 
 // Written by Janelle Clark, based off code by Evan Pezent
 
@@ -18,6 +27,44 @@ public:
         Running = 1,
         Error = 2
     };
+    /// What the hub does when a tick overruns its period. Missed deadlines are always
+    /// skipped, so the timer resyncs instead of running a burst of late ticks.
+    enum OverrunPolicy : int {
+        CatchUp = 0,   ///< skip missed deadlines and carry on with all work
+        Shed = 1,      ///< also shed telemetry (Queries, FBuff) until ticks are back on time
+        SafeHold = 2   ///< also command zero torque after holdAfter and disable devices after disableAfter consecutive overruns
+    };
+    /// Degradation level the hub is running at
+    enum OverrunMode : int {
+        Nominal = 0,   ///< all work scheduled
+        Shedding = 1,  ///< telemetry shed
+        Holding = 2,   ///< telemetry shed, zero torque commanded
+        Disabled = 3   ///< devices were disabled, waiting to recover
+    };
+    /// Overrun policy settings
+    struct OverrunConfig {
+        OverrunPolicy policy = CatchUp;
+        int holdAfter = 3;        ///< consecutive overruns before Holding (SafeHold)
+        int disableAfter = 10;    ///< consecutive overruns before Disabled (SafeHold)
+        int recoverAfter = 100;   ///< consecutive on time ticks before returning to Nominal
+    };
+    /// Entry in the hub event log
+    struct Event {
+        enum Type : int {
+            Overrun = 0,      ///< a tick overran its period
+            ModeChange = 1,   ///< the hub changed OverrunMode
+            SafetyTrip = 2    ///< the supervisor disabled a device
+        };
+        Type type = Overrun;
+        std::int64_t tick = 0;  ///< timer tick the event happened on
+        double time = 0;        ///< [s] elapsed hub time
+        int missed = 0;         ///< deadlines missed by this tick
+        int consecutive = 0;    ///< consecutive overrunning ticks
+        OverrunMode from = Nominal;
+        OverrunMode to = Nominal;
+        int device = -1;        ///< ID of the tripped device (SafetyTrip)
+        int cause = 0;          ///< CM::Trip bits (SafetyTrip)
+    };
     /// Hub Query
     struct Query {
         Status status = Idle;
@@ -27,8 +74,30 @@ public:
         int misses = 0;
         double missRate = 0;
         double waitRatio = 0;
+        double sleepRatio = 0;
+        double timerMargin = 0;
         int lockCount = 0;
         double loopRate = 0;
+        int queryRetries = 0;
+        RtStatus rt;
+        int workers = 1;            ///< threads sharing device updates (including the control thread)
+        double outerRate = 0;       ///< position loop rate [Hz]
+        double telemetryRate = 0;   ///< Query publishing rate [Hz]
+        OverrunMode overrunMode = Nominal;
+        int overruns = 0;           ///< consecutive overrunning ticks
+        int logDropped = 0;         ///< control thread log messages lost to a full AsyncLog ring
+        LatencyStats tickPeriod;    ///< time between successive ticks [us]
+        LatencyStats wakeLateness;  ///< tick start after its ideal deadline [us]
+        LatencyStats computeTime;   ///< time spent in the tick [us]
+    };
+    /// Hub Timing Report (running statistics since the last reset)
+    struct TimingReport {
+        TimingStats read;                    ///< daq.read_all
+        TimingStats devices;                 ///< all device updates
+        TimingStats kernel;                  ///< CMBank lane kernel (part of devices)
+        TimingStats write;                   ///< daq.write_all
+        TimingStats tick;                    ///< whole update
+        std::map<int, TimingStats> device;   ///< per device ID, excluding the shared kernel
     };
     /// Hub Error Codes
     enum ErrorCode : int {
@@ -40,8 +109,9 @@ public:
         DaqEnableFailed = -5,
         UpdateFailed = -6
     };
-    /// Constructor
-    CMHub(int Fs = 1000);
+    /// Constructor. If simulated, devices are created on sim and driven by capstan plants instead of the Q8-USB.
+    /// Simulated devices must be created before start()
+    CMHub(int Fs = 1000, bool simulated = false);
     /// Destructor
     ~CMHub();
     /// Initializes a base CM device to this Daq with a AI force sensor
@@ -60,26 +130,132 @@ public:
     bool validateDeviceId(int id);
     /// Returns the device with ID, nullptr if no device with ID exists (thread safe)
     std::shared_ptr<CM> getDevice(int id);
-    /// Returns a full query of the CMHub (thread safe)
+    /// Returns a full query of the CMHub (thread safe, lock-free unless immediate)
     Query getQuery(bool immediate = false);
+    /// Returns per-phase and per-device update timing as of the last telemetry tick. If reset, the control
+    /// thread clears the statistics at the start of its next tick (thread safe, lock-free, empty if built with
+    /// CM_TIMING off)
+    TimingReport getTimingReport(bool reset = false);
     /// Sets hub sampling rate (default = 500 Hz)
     void setSampleRate(int Fs);
+    /// Runs position loops every outerDivider ticks and telemetry (device and hub Queries, FBuff) every
+    /// telemetryDivider ticks, phase-locked to the hub timer. Sensing, force and torque loops run every tick
+    /// (e.g. setSampleRate(4000) with dividers 4 and 16 gives 4 kHz force, 1 kHz position, 250 Hz telemetry) (thread safe)
+    void setRateGroups(int outerDivider, int telemetryDivider);
+    /// Sets what the hub does when ticks overrun their period (thread safe)
+    void setOverrunPolicy(const OverrunConfig& config);
+    /// Enables the supervisor, which checks every device's velocity, torque and user force/position limits
+    /// each tick and disables violators before outputs are written (default = enabled, thread safe)
+    void setSupervisor(bool enable);
+    /// Overrun state machine: the mode after a tick that missed missed deadlines, given the consecutive
+    /// overrunning (overruns) and on time (onTime) tick counts including that tick
+    static OverrunMode nextOverrunMode(const OverrunConfig& config, OverrunMode mode, std::int64_t missed, int overruns, int onTime);
+    /// Reads hub events logged after cursor and advances it, returns the number read. Events
+    /// overwritten before they were read are skipped (thread safe, lock-free)
+    std::size_t readEvents(std::uint64_t& cursor, std::vector<Event>& events) const;
+    /// Sets how the hub waits between ticks (default = Busy; Hybrid frees the core but check
+    /// getTimingReport lateness and miss rate on the target machine before switching)
+    void setWaitMode(HybridTimer::WaitMode mode);
+    /// Sets the real-time settings applied to the control thread on the next start (thread safe)
+    void setRtConfig(const RtConfig& config);
+    /// Splits device updates across workers threads (including the control thread) from
+    /// the next start, each extra worker pinned to the matching entry of cpus (thread safe)
+    void setWorkers(int workers, const std::vector<int>& cpus = {});
 
 public:
+#ifdef CM_Q8
     mahi::daq::Q8Usb daq; ///< the DAQ that all CMs run on
+#endif
+    SimDaq sim;           ///< the DAQ that all CMs run on when simulated (always, without CM_Q8)
 private:
+    /// Immutable, contiguous snapshot of the devices. Add/destroy publish a
+    /// replacement and the control thread picks it up at the next tick without locking.
+    struct DeviceTable {
+        std::vector<int>                 ids;      ///< sorted device IDs
+        std::vector<std::shared_ptr<CM>> devices;  ///< device per ID
+        CMBank                           bank;     ///< updates devices in one pass
+        /// Returns the device with ID, nullptr if none
+        std::shared_ptr<CM> find(int id) const;
+    };
+    /// Copies the current table into a map for editing (caller holds m_registryMutex)
+    std::map<int, std::shared_ptr<CM>> deviceMap() const;
+    /// Publishes a new table and frees the old one after a grace period (caller holds m_registryMutex)
+    void publishTable(const std::map<int, std::shared_ptr<CM>>& devices);
+    /// Moves bank state over to the newest table if it changed (control thread or thread inactive, holds m_mutex)
+    void adoptTable();
+    /// Creates a device on sim with a plant wired to its channels (force is the AI channel of forceAxis),
+    /// nullptr if the control thread is running
+    std::shared_ptr<CM> createSimDevice(int id, int enable, int fault, int command, int encoder, int force, Axis forceAxis);
     void controlThreadFunction(bool soft);
+    /// Reads or writes every channel of the active DAQ
+    bool readAll();
+    bool writeAll();
     bool update();
     bool updateSoft();
     void fillQuery(Query& q);
+    void publishQuery();
+    /// Copies the phase and device timing into m_timingPublished (control thread)
+    void publishTiming();
+    void recordTickStart(const mahi::util::Time& t);
+    void recordTickEnd(const mahi::util::Time& t);
+    /// Work scheduled on the current timer tick
+    CMBank::Tick scheduleTick() const;
+    /// True if hub telemetry is due on the current timer tick
+    bool telemetryTick() const;
+    /// Applies the overrun policy to the deadlines missed since the last tick (control thread, holds m_mutex)
+    void handleOverrun();
+    /// Logs a change of overrun mode
+    void setOverrunMode(OverrunMode mode, std::int64_t missed);
+    /// Logs devices the supervisor tripped on this tick
+    void recordTrips();
 private:
+    const bool m_simulated;
     Status m_status;
     Query m_q;
-    mahi::util::Timer m_timer;
+    Seqlock<Query> m_qPublished;
+    HybridTimer m_timer;
     mahi::util::ctrl_bool m_running;
     std::thread m_controlThread;
     std::mutex m_mutex;
     int m_lockCount;
-    std::map<int, std::shared_ptr<CM>> m_devices;
+    std::mutex m_registryMutex;
+    std::atomic<DeviceTable*> m_table;    ///< newest device table
+    DeviceTable* m_current;               ///< table the control thread is running (holds bank state)
+    std::atomic<std::uint64_t> m_epoch;   ///< completed ticks, for reclaiming old tables
+    std::atomic<bool> m_threadActive;     ///< control thread may be reading a table
+    std::atomic<int> m_deviceCount;
     RateMonitor m_loopRate;
+    /// Fixed-size TimingReport, so it can be published through a Seqlock
+    struct TimingSnapshot {
+        static constexpr int MaxDevices = 64;
+        TimingStats read, devices, kernel, write, tick;
+        int deviceCount = 0;
+        int ids[MaxDevices];
+        TimingStats device[MaxDevices];
+    };
+    TimingSnapshot m_timing;              ///< phase timing (control thread only)
+    Seqlock<TimingSnapshot> m_timingPublished;
+    std::atomic<bool> m_timingReset;      ///< set by getTimingReport, cleared by the control thread
+    LatencyHistogram m_periodHist;
+    LatencyHistogram m_latenessHist;
+    LatencyHistogram m_computeHist;
+    LatencyStats m_periodStats;
+    LatencyStats m_latenessStats;
+    LatencyStats m_computeStats;
+    mahi::util::Time m_lastTick;
+    int m_statsCountdown;
+    RtConfig m_rtConfig;
+    RtStatus m_rtStatus;
+    int m_workers;
+    int m_outerDivider;
+    int m_telemetryDivider;
+    std::vector<int> m_workerCpus;
+    std::unique_ptr<WorkerPool> m_pool;  ///< exists while the control thread runs with m_workers > 1
+    OverrunConfig m_overrun;
+    bool m_supervise;
+    OverrunMode m_overrunMode;
+    int m_overruns;                      ///< consecutive overrunning ticks
+    int m_onTime;                        ///< consecutive on time ticks
+    std::int64_t m_missesSeen;           ///< timer misses already handled
+    TelemetryRing<Event> m_events;       ///< event log (written by the control thread only)
 };
\ No newline at end of file
@@ -0,0 +1,181 @@
+#include "CMReplay.hpp"
+#include "Util/SimDaq.hpp"
+#include <Mahi/Util.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+using namespace mahi::daq;
+using namespace mahi::util;
+using namespace mahi::robo;
+
+int CMReplay::Recording::column(const std::string& name) const {
+    for (std::size_t i = 0; i < header.size(); ++i) {
+        if (header[i] == name)
+            return (int)i;
+    }
+    return -1;
+}
+
+CMReplay::CMReplay(const CM::Params& params, CM::ControlMode mode, CM::FilterMode forceFilter, CM::FilterMode dFdtFilter) :
+    m_params(params),
+    m_mode(mode),
+    m_forceFilter(forceFilter),
+    m_dFdtFilter(dFdtFilter)
+{ }
+
+bool CMReplay::importParams(const std::string& filepath) {
+    // reuse CM's JSON import on a throwaway device
+    VirtualDaq daq;
+    // CM owns (and deletes) its force sensor
+    SimForceSensor* sensor = new SimForceSensor(&daq.AI[0], 1.0);
+    double zero = 0;
+    CM::Io io = {
+        DOHandle(daq.DO,0),
+        DIHandle(daq.DI,0),
+        AOHandle(daq.AO,0),
+        EncoderHandle(daq.encoder,0),
+        *sensor,
+        Axis::AxisX,
+        &zero,
+        &zero
+    };
+    CM cm("cm_replay", io, m_params);
+    if (!cm.importParams(filepath))
+        return false;
+    m_params = cm.getParams();
+    return true;
+}
+
+bool CMReplay::run(const Recording& recording, const Channels& channels, std::vector<Sample>& samples) const {
+    const int tc = recording.column(channels.time);
+    const int fc = recording.column(channels.force);
+    const int pc = recording.column(channels.position);
+    const int rc = channels.reference.empty() ? -1 : recording.column(channels.reference);
+    if (fc < 0 || pc < 0 || (!channels.reference.empty() && rc < 0)) {
+        LOG(Error) << "Replay of " << recording.name << " is missing a force, position or reference column.";
+        return false;
+    }
+
+    // fake sensors: recorded values are after the sense sign flips, so undo them here
+    const double forceSign = m_params.forceSenseSignFlip ? -1.0 : 1.0;
+    const double posSign   = m_params.posSenseSignFlip ? -1.0 : 1.0;
+    double force = 0, countsPerSecond = 0, velocity = 0;
+    int    counts = 0;
+    VirtualDaq daq;
+    daq.AI.sources[0]      = [&force](Time) { return force; };
+    daq.encoder.sources[0] = [&counts](Time) { return counts; };
+    // CM owns (and deletes) its force sensor
+    SimForceSensor* sensor = new SimForceSensor(&daq.AI[0], 1.0);
+
+    CM::Io io = {
+        DOHandle(daq.DO,0),
+        DIHandle(daq.DI,0),
+        AOHandle(daq.AO,0),
+        EncoderHandle(daq.encoder,0),
+        *sensor,
+        Axis::AxisX,
+        &countsPerSecond,
+        &velocity
+    };
+    CM cm("cm_replay", io, m_params);
+    cm.setControlMode(m_mode);
+    cm.setForceFilterMode(m_forceFilter);
+    cm.setdFdtFilterMode(m_dFdtFilter);
+    daq.open();
+    daq.enable();
+    cm.enable();
+
+    samples.clear();
+    samples.reserve(recording.rows.size());
+    double lastTime = 0, lastDeg = 0, ctrlValue = 0;
+    for (std::size_t i = 0; i < recording.rows.size(); ++i) {
+        const std::vector<double>& row = recording.rows[i];
+        double time = tc >= 0 ? row[tc] : i * channels.samplePeriod;
+        double deg  = row[pc] / m_params.gearRatio;
+        // encoder velocity as the Q8 would report it (finite difference of position)
+        velocity        = (i > 0 && time > lastTime) ? posSign * (deg - lastDeg) / (time - lastTime) : 0.0;
+        countsPerSecond = velocity / m_params.degPerCount;
+        counts          = (int)std::lround(posSign * deg / m_params.degPerCount);
+        force           = forceSign * row[fc];
+        daq.read_all();
+        if (rc >= 0) {
+            double ref = m_mode == CM::ControlMode::Position ? row[rc] / m_params.gearRatio : row[rc];
+            ctrlValue  = cm.scaleRefToCtrlValue(ref);
+            cm.setControlValue(ctrlValue);
+        }
+        cm.update(seconds(time));
+
+        Sample s;
+        s.time          = time;
+        s.force         = cm.getForce(false);
+        s.forceFiltered = cm.getForce(true);
+        s.dFdt          = cm.getdFdt(false);
+        s.dFdtFiltered  = cm.getdFdt(true);
+        s.position      = cm.getSpoolPosition();
+        s.ctrlValue     = ctrlValue;
+        s.torque        = cm.getMotorTorqueCommand();
+        samples.push_back(s);
+        lastTime = time;
+        lastDeg  = deg;
+    }
+    cm.disable();
+    daq.disable();
+    daq.close();
+    return true;
+}
+
+bool CMReplay::load(const std::string& filepath, Recording& recording) {
+    std::ifstream file(filepath);
+    if (!file.is_open()) {
+        LOG(Error) << "Could not open recording " << filepath << ".";
+        return false;
+    }
+    recording = Recording();
+    recording.name = filepath;
+    std::string line, cell;
+    if (std::getline(file, line)) {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        std::stringstream ss(line);
+        std::vector<std::string> raw;
+        while (std::getline(ss, cell, ',')) {
+            // repeated names get a suffix (older sessions write deltaN twice)
+            long repeats = std::count(raw.begin(), raw.end(), cell);
+            raw.push_back(cell);
+            recording.header.push_back(repeats ? cell + "_" + std::to_string(repeats + 1) : cell);
+        }
+    }
+    std::vector<double> row;
+    while (std::getline(file, line)) {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        std::stringstream ss(line);
+        row.clear();
+        bool numeric = true;
+        while (numeric && std::getline(ss, cell, ',')) {
+            char* end = nullptr;
+            double value = std::strtod(cell.c_str(), &end);
+            numeric = end != cell.c_str();
+            row.push_back(value);
+        }
+        if (numeric && row.size() >= recording.header.size())
+            recording.rows.push_back(row);
+    }
+    return true;
+}
+
+bool CMReplay::save(const std::string& filepath, const std::vector<Sample>& samples) {
+    std::ofstream file(filepath);
+    if (!file.is_open())
+        return false;
+    // round-trip precision, so saved runs can be compared bit for bit
+    file << std::setprecision(17);
+    file << "Time,Force,ForceFiltered,dFdt,dFdtFiltered,Position,CtrlValue,Torque\n";
+    for (auto& s : samples)
+        file << s.time << ',' << s.force << ',' << s.forceFiltered << ',' << s.dFdt << ',' << s.dFdtFiltered << ','
+             << s.position << ',' << s.ctrlValue << ',' << s.torque << '\n';
+    return true;
+}
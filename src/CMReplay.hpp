@@ -0,0 +1,64 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "CapstanModule.hpp"
+
+/// Replays recorded timeseries through a CM as fast as the CPU allows. Each
+/// recorded row drives a fake force sensor and encoder on a virtual DAQ, then
+/// CM::update runs at the recorded timestamp, so filters, dFdt and controller
+/// outputs are regenerated for whatever Params are being evaluated. No timers
+/// or threads are involved and every run starts from a fresh CM, so the same
+/// recording and Params always give bit-identical results.
+class CMReplay {
+public:
+    /// A recorded CSV (header plus numeric rows)
+    struct Recording {
+        std::string                      name;    ///< file the recording came from
+        std::vector<std::string>         header;  ///< column names (repeats suffixed _2, _3, ...)
+        std::vector<std::vector<double>> rows;    ///< one entry per column per row
+        /// Index of a column, -1 if missing
+        int column(const std::string& name) const;
+    };
+
+    /// Recording columns to replay
+    struct Channels {
+        std::string time         = "Time";   ///< [s], rows are samplePeriod apart if missing
+        std::string force        = "NormF";  ///< [N] measured force
+        std::string position     = "NormP";  ///< [mm] measured spool position
+        std::string reference    = "";       ///< optional control reference in the units of the mode (spool mm for Position)
+        double      samplePeriod = 1.0 / 90.0; ///< [s] used when there is no time column (GUI frame rate)
+    };
+
+    /// Regenerated signals for one row
+    struct Sample {
+        double time          = 0;  ///< [s]
+        double force         = 0;  ///< [N]
+        double forceFiltered = 0;  ///< [N]
+        double dFdt          = 0;  ///< [N/s]
+        double dFdtFiltered  = 0;  ///< [N/s]
+        double position      = 0;  ///< [mm] spool
+        double ctrlValue     = 0;  ///< [0,1]
+        double torque        = 0;  ///< [Nm] motor torque command
+    };
+
+    /// Constructor
+    CMReplay(const CM::Params& params, CM::ControlMode mode = CM::ControlMode::Torque,
+             CM::FilterMode forceFilter = CM::FilterMode::Lowpass, CM::FilterMode dFdtFilter = CM::FilterMode::Lowpass);
+    /// Replaces the replayed Params with a JSON export from CM::exportParams
+    bool importParams(const std::string& filepath);
+    /// Params being replayed
+    const CM::Params& params() const { return m_params; }
+    /// Runs one recording through a fresh CM, returns false if a column is missing
+    bool run(const Recording& recording, const Channels& channels, std::vector<Sample>& samples) const;
+    /// Loads a CSV recording, skipping rows that are not fully numeric
+    static bool load(const std::string& filepath, Recording& recording);
+    /// Writes samples to CSV
+    static bool save(const std::string& filepath, const std::vector<Sample>& samples);
+
+private:
+    CM::Params      m_params;
+    CM::ControlMode m_mode;
+    CM::FilterMode  m_forceFilter;
+    CM::FilterMode  m_dFdtFilter;
+};
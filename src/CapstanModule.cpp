@@ -1,8 +1,11 @@
 #include <Mahi/Util/Logging/Log.hpp>
 #include <Mahi/Util/Math/Functions.hpp>
 #include "CapstanModule.hpp"
+#include "Util/AsyncLog.hpp"
+#include <algorithm>
 #include <filesystem>
 #include <fstream>
+#include <limits>
 
 // Written by Janelle Clark with Nathan Dunkelberger, based off code by Evan Pezent
 
@@ -10,6 +13,18 @@ using namespace mahi::daq;
 using namespace mahi::util;
 namespace fs = std::filesystem;
 
+// messages from code that can run every tick go through AsyncLog, repeats at most once a second per CM
+namespace {
+    AsyncLog::Format ClampTorqueLog(Warning, "Control value {} clamped by thresholds -1.0 and 1.0");
+    AsyncLog::Format ClampLog(Warning, "Control value {} clamped by thresholds 0.0 and 1.0");
+    AsyncLog::Format ClampSegmentLog(Warning, "Segment target {} clamped by thresholds {} and 1.0");
+    AsyncLog::Format VelocityLimitLog(Error, "Capstan Module {} velocity exceeded the velocity limit {} deg/s with a value of {} deg/s.");
+    AsyncLog::Format TorqueLimitLog(Error, "Capstan Module {} command torque exceeded the torque limit {} Nm with a value of {} Nm.");
+    AsyncLog::Format ScaleTorqueLog(Info, "Reference value {} Nm for CM {} converted to {} for torque control.");
+    AsyncLog::Format ScaleUnknownLog(Info, "Control scheme not found for scaling control reference value ].");
+    AsyncLog::Format DroppedCommandLog(Warning, "CM {} command queue is full (is the CMHub running?). {} commands dropped so far.");
+}
+
 CM::CM(const std::string &name, Io io, Params config) :
     Device(name),
     m_status(Status::Disabled),
@@ -18,28 +33,50 @@ CM::CM(const std::string &name, Io io, Params config) :
     m_Q(10000),
     m_positionPd(config.positionKp, config.positionKd),
     m_forcePID(0,0,0),
-    m_ctrlFilter(2, 0.02, Butterworth::Lowpass),
-    m_forceFiltMode(FilterMode::Lowpass),
-    m_forceFilterL(2,0.2),
-    m_forceFilterM(100),
-    m_dFdtFiltMode(FilterMode::Lowpass),
-    m_dFdtFilterL(2, 0.2),
-    m_dFdtFilterM(100),
-    m_outputFilter(2,config.outputFilterCutoff,Butterworth::Lowpass),
+    m_ctrlFilter(Biquad::butterworth(0.02)),
+    m_outputFilter(Biquad::butterworth(config.outputFilterCutoff)),
     m_posDiff(),
-    m_velocityFilter(2,0.1),
+    m_velocityFilter(Biquad::butterworth(0.1)),
     m_ctrlValue(0.0),
     m_ctrlValueFiltered(0.0),
     m_feedRate(seconds(0.5)),
-    m_customController(std::make_shared<CMController>())
+    m_segmentsDone(0),
+    m_segmentsQueued(0),
+    m_streamOffset(0),
+    m_userForceMin(-std::numeric_limits<double>::infinity()),
+    m_userForceMax(std::numeric_limits<double>::infinity()),
+    m_userPositionMin(-std::numeric_limits<double>::infinity()),
+    m_userPositionMax(std::numeric_limits<double>::infinity()),
+    m_tripCause(Trip::NoTrip),
+    m_customController(std::make_shared<CMController>()),
+    m_controller(TorqueLoop()),
+    m_cmdSign(1.0),
+    m_commands(1024),
+    m_retired(16),
+    m_paramsRequested(config),
+    m_ctrlModeRequested(ControlMode::Torque),
+    m_droppedCommands(0),
+    m_configVersion(0),
+    m_controlThread(std::thread::id()),
+    m_lockCount(0)
 {
-    setParams(config);
+    m_forceFilter.for_each<LowpassStage>([](LowpassStage& f) { f.set_coefficients(Biquad::butterworth(0.2)); });
+    m_dFdtFilter.for_each<LowpassStage>([](LowpassStage& f) { f.set_coefficients(Biquad::butterworth(0.2)); });
+    m_forceFilter.select(FilterMode::Lowpass);
+    m_dFdtFilter.select(FilterMode::Lowpass);
+    PreparedParams prepared(config);
+    applyParams(prepared);
+    resolveController();
     LOG(Info) << "Created CM " << this->name() << ".";
 }
 
 CM::~CM() {
     if (is_enabled())
         disable();
+    Command cmd;
+    while (m_commands.pop(cmd))
+        delete cmd.prepared;
+    freeRetiredParams();
     LOG(Info) << "Destroyed CM " << name() << ".";
 
     if (&m_io.forceCh != nullptr) delete &m_io.forceCh;
@@ -50,49 +87,68 @@ CM::~CM() {
 //=============================================================================
 
 void CM::update(const Time &t) {
-    TASBI_LOCK
+    TASBI_UPDATE_LOCK
+    beginUpdate(t);
     // filter incomming control value
-    m_t = t;
     m_ctrlValueFiltered  = m_ctrlFilter.update(m_ctrlValue);
     double ctrlValueUsed = m_params.filterControlValue ? m_ctrlValueFiltered : m_ctrlValue;
-    auto vel = m_posDiff.update(getMotorPosition(), t);
-    m_velocityFilter.update(vel);
     // control update
-    getForce(true, true);
-    getdFdt(true, true);
     if (m_status == Status::Enabled)
         controlUpdate(ctrlValueUsed);
+    endUpdate(t);
+};
+
+void CM::beginUpdate(const Time& t, bool sense) {
+    // the sensor getters read m_sample directly on this thread only
+    m_controlThread.store(std::this_thread::get_id(), std::memory_order_relaxed);
+    // apply commands posted since the last tick
+    drainCommands();
+    // producers stamp streamed values on the tick clock through this offset; a jump means the
+    // hub (re)started, so move queued samples onto the new time base
+    double offset = t.as_seconds() - SetpointStream::clock();
+    double shift  = offset - m_streamOffset.load(std::memory_order_relaxed);
+    if (std::abs(shift) > 0.1)
+        m_stream.rebase(shift);
+    m_streamOffset.store(offset, std::memory_order_relaxed);
+    // streamed setpoints and trajectories own the setpoint while they are active
+    if (m_stream.active()) {
+        m_ctrlValue = m_stream.evaluate(t.as_seconds());
+    }
+    else if (m_trajectory.active()) {
+        std::size_t completed;
+        m_ctrlValue = m_trajectory.evaluate(t.as_seconds(), m_ctrlValue, completed);
+        m_segmentsDone.fetch_add(completed, std::memory_order_release);
+    }
+    // read sensors once for this tick (CMBank reads them itself to batch the input filters)
+    m_t = t;
+    if (sense)
+        acquire(t);
+}
+
+void CM::endUpdate(const Time& t, bool telemetry) {
     // update feedrate
     m_feedRate.update(t);
-    // update fixed query
-    fillQuery(m_q);
-    m_q.time = t.as_microseconds();
-    m_Q.push_back(m_q);
+    m_stream.update(t.as_seconds());
+    if (telemetry) {
+        // update fixed query
+        fillQuery(m_q);
+        m_q.time = t.as_microseconds();
+        m_qPublished.store(m_q);
+        m_Q.push_back(m_q);
+    }
     // on update
     onUpdate();
     // Force RingBuffer
-    FBuff.push_back(getForce());
+    if (telemetry)
+        FBuff.push_back(m_sample.forceFiltered);
     // reset lockcount
     m_lockCount = 0;
-};
+}
 
 void CM::setParams(CM::Params config) {
-    TASBI_LOCK
-    m_params = config;
-    // these need to be udpated now
-    m_io.encoderCh.set_units(m_params.degPerCount);
-    m_positionPd.kp = m_params.positionKp;
-    m_positionPd.kd = m_params.positionKd;
-    m_forcePd.kp = m_params.forceKp;
-    m_forcePd.kd = m_params.forceKd;
-    m_ctrlFilter.configure(2, m_params.cvFilterCutoff);
-    // m_forceFilterL.configure(2, m_params.forceFilterCutoff);
-    m_forceFilterM.resize(m_params.forceFilterN);
-    m_dFdtFilterL.configure(2, m_params.dFdtFilterCutoff);
-    m_dFdtFilterM.resize(m_params.forceFilterN);
-    m_outputFilter.configure(2, m_params.outputFilterCutoff);
-    m_velocityFilter.configure(2, m_params.velFilterCutoff);
-    m_forcePID.setPID(m_params.forceKp, m_params.forceKi, m_params.forceKd);
+    std::lock_guard<std::mutex> cmdLock(m_cmdMutex);
+    m_paramsRequested = config;
+    postParams(config);
 }
 
 bool CM::exportParams(const std::string& filepath) {
@@ -132,6 +188,7 @@ bool CM::exportParams(const std::string& filepath) {
     j["forceKff"]            = params.forceKff;
     j["forceFilterCutoff"]   = params.forceFilterCutoff;
     j["forceFilterN"]        = params.forceFilterN;
+    j["forceFilterAvgN"]     = params.forceFilterAvgN;
     j["cvFilterCutoff"]      = params.cvFilterCutoff;
     j["filterControlValue"]  = params.filterControlValue;
     j["outputFilterCutoff"]  = params.outputFilterCutoff;
@@ -189,6 +246,7 @@ bool CM::importParams(const std::string& filepath) {
             params.forceKff           = j["forceKff"].get<double>();
             params.forceFilterCutoff  = j["forceFilterCutoff"].get<double>();
             params.forceFilterN       = j["forceFilterN"].get<int>();
+            params.forceFilterAvgN    = j.value("forceFilterAvgN", params.forceFilterAvgN);
             params.cvFilterCutoff     = j["cvFilterCutoff"].get<double>();
             params.filterControlValue = j["filterControlValue"].get<bool>();
             params.outputFilterCutoff = j["outputFilterCutoff"].get<double>();
@@ -210,22 +268,23 @@ bool CM::importParams(const std::string& filepath) {
 }
 
 CM::Params CM::getParams() const {
-    TASBI_LOCK
-    return m_params;
+    std::lock_guard<std::mutex> cmdLock(m_cmdMutex);
+    return m_paramsRequested;
 }
 
 CM::Query CM::getQuery(bool immediate) {
-    TASBI_LOCK
     if (immediate) {
+        TASBI_LOCK
         Query q;
         fillQuery(q);
         return q;
     }
-    return m_q;
+    return m_qPublished.load();
 }
 
 void CM::dumpQueries(const std::string& filepath) {
-    TASBI_LOCK
+    std::vector<Query> Q;
+    m_Q.snapshot(Q);
     Csv csv(filepath);
     if (csv.is_open()) {
         csv.write_row("time",
@@ -237,8 +296,6 @@ void CM::dumpQueries(const std::string& filepath) {
                       "motorTorqueCommand",
                       "spoolPosition",
                       "spoolVelocity",
-                      "forceRaw",
-                      "forceRawFiltered",
                       "force",
                       "forceFiltered",
                       "ctrlMode",
@@ -248,9 +305,17 @@ void CM::dumpQueries(const std::string& filepath) {
                       "ctrlValueScaled",
                       "lockCount",
                       "feedRate",
-                      "dFdt");
-        for (int i = 0; i < m_Q.size(); ++i) {
-            Query& q = m_Q[i];
+                      "dFdt",
+                      "dFdtFiltered",
+                      "feedInterval",
+                      "feedJitter",
+                      "feedIntervalMax",
+                      "feedStarved",
+                      "queryRetries",
+                      "tripCause",
+                      "droppedCommands");
+        for (std::size_t i = 0; i < Q.size(); ++i) {
+            const Query& q = Q[i];
             csv.write_row(q.time,          
                           q.status,            
                           q.counts,            
@@ -269,15 +334,25 @@ void CM::dumpQueries(const std::string& filepath) {
                           q.ctrlValueScaled,   
                           q.lockCount,         
                           q.feedRate,          
-                          q.dFdt);
+                          q.dFdt,
+                          q.dFdtFiltered,
+                          q.feedInterval,
+                          q.feedJitter,
+                          q.feedIntervalMax,
+                          q.feedStarved,
+                          q.queryRetries,
+                          q.tripCause,
+                          q.droppedCommands);
         }
         csv.close();
     }
 }
 
 void CM::setPosCtrlCmdSign(bool cmdSignFlip) {
-    m_params.posCmdSignFlip = cmdSignFlip;
-    if (m_params.posCmdSignFlip == 0)
+    std::lock_guard<std::mutex> cmdLock(m_cmdMutex);
+    m_paramsRequested.posCmdSignFlip = cmdSignFlip;
+    postCommand(Command::SetPosCmdSign, 0, 0, 0, cmdSignFlip);
+    if (cmdSignFlip == 0)
         std::cout << "device:  " << name() << " command current as wired (flip = 0) for Position Control" << std::endl;
     else
         std::cout << "device:  " << name() << " command current is flipped (flip = 1) For Position Control" << std::endl;
@@ -285,34 +360,38 @@ void CM::setPosCtrlCmdSign(bool cmdSignFlip) {
 }
 
 void CM::setForceCtrlCmdSign(bool cmdSignFlip) {
-        m_params.forceCmdSignFlip = cmdSignFlip;
-        if (m_params.forceCmdSignFlip == 0)
+        std::lock_guard<std::mutex> cmdLock(m_cmdMutex);
+        m_paramsRequested.forceCmdSignFlip = cmdSignFlip;
+        postCommand(Command::SetForceCmdSign, 0, 0, 0, cmdSignFlip);
+        if (cmdSignFlip == 0)
             std::cout << "device:  " << name() << " command current as wired (flip = 0) for Force/Torque Control" << std::endl;
         else
             std::cout << "device:  " << name() << " command current is flipped (flip = 1) For Force/Torque Control" << std::endl;
 }
 
 void CM::setPositionSenseSign(bool posSignFlip) {
-    
-    m_params.posSenseSignFlip = posSignFlip;
-    if (m_params.posSenseSignFlip == 0)
+    std::lock_guard<std::mutex> cmdLock(m_cmdMutex);
+    m_paramsRequested.posSenseSignFlip = posSignFlip;
+    postCommand(Command::SetPosSenseSign, 0, 0, 0, posSignFlip);
+    if (posSignFlip == 0)
         std::cout << "device:  " << name() << " position sensing as wired (flip = 0)" << std::endl;
     else
         std::cout << "device:  " << name() << " position sensing sign is flipped (flip = 1)" << std::endl;
 }
 
 void CM::setForceSenseSign(bool forceSignFlip) {
-    
-    m_params.forceSenseSignFlip = forceSignFlip;
-    if (m_params.forceSenseSignFlip == 0)
+    std::lock_guard<std::mutex> cmdLock(m_cmdMutex);
+    m_paramsRequested.forceSenseSignFlip = forceSignFlip;
+    postCommand(Command::SetForceSenseSign, 0, 0, 0, forceSignFlip);
+    if (forceSignFlip == 0)
         std::cout << "device:  " << name() << " force sensing as wired (flip = 0)" << std::endl;
     else
         std::cout << "device:  " << name() << " force sensing sign is flipped (flip = 1)" << std::endl;
 }
 
 void CM::zeroForce(){
-    TASBI_LOCK
-    m_io.forceCh.zero();
+    std::lock_guard<std::mutex> cmdLock(m_cmdMutex);
+    postCommand(Command::ZeroForce);
 }
 
 void CM::zeroPosition() {
@@ -333,75 +412,81 @@ void CM::zeroPosition(double position) {
 }
 
 void CM::setVelocityMax(double vel, bool has_limit_) {
-    TASBI_LOCK
-    m_params.velocityMax = vel;
-    m_params.has_velocity_limit_ = has_limit_;
+    std::lock_guard<std::mutex> cmdLock(m_cmdMutex);
+    m_paramsRequested.velocityMax = vel;
+    m_paramsRequested.has_velocity_limit_ = has_limit_;
+    postCommand(Command::SetVelocityMax, vel, 0, 0, has_limit_);
     LOG(Info) << "Set CM " << name() << " velocity maximum to " << vel << " deg/s.";
 }
 
 void CM::setTorqueMax(double torque, bool has_limit_) {
-    TASBI_LOCK
-    m_params.has_torque_limit_ = has_limit_;
-    if (abs(torque)>m_params.motorStallTorque){
-        m_params.torqueMax = torque*m_params.motorStallTorque/abs(torque); // tor/abs(tor) to maintain sign of output
-        LOG(Info) << "Torque limit of " << torque << " Nm is higher than motor stall torque, " << m_params.motorStallTorque << " Nm for CM " << name() << ". Torque max set at stall torque.";
+    std::lock_guard<std::mutex> cmdLock(m_cmdMutex);
+    m_paramsRequested.has_torque_limit_ = has_limit_;
+    if (abs(torque)>m_paramsRequested.motorStallTorque){
+        m_paramsRequested.torqueMax = torque*m_paramsRequested.motorStallTorque/abs(torque); // tor/abs(tor) to maintain sign of output
+        LOG(Info) << "Torque limit of " << torque << " Nm is higher than motor stall torque, " << m_paramsRequested.motorStallTorque << " Nm for CM " << name() << ". Torque max set at stall torque.";
     }
     else{
-        m_params.torqueMax = torque;
+        m_paramsRequested.torqueMax = torque;
         LOG(Info) << "Set CM " << name() << " torque maximum to " << torque << " Nm .";
     }
+    postCommand(Command::SetTorqueMax, m_paramsRequested.torqueMax, 0, 0, has_limit_);
 }
 
 void CM::setPositionRange(double min, double max) {
-    TASBI_LOCK
-    m_params.positionMin = min;
-    m_params.positionMax = max;
+    std::lock_guard<std::mutex> cmdLock(m_cmdMutex);
+    m_paramsRequested.positionMin = min;
+    m_paramsRequested.positionMax = max;
+    postCommand(Command::SetPositionRange, min, max);
     //LOG(Info) << "Set CM " << name() << " position range to [ " << min << " , " << max << " mm].";
 }
 
 void CM::setPositionGains(double kp, double kd) {
-    TASBI_LOCK
-    m_params.positionKp = kp;
-    m_params.positionKd = kd;
-    m_positionPd.kp    = kp;
-    m_positionPd.kd    = kd;
+    std::lock_guard<std::mutex> cmdLock(m_cmdMutex);
+    m_paramsRequested.positionKp = kp;
+    m_paramsRequested.positionKd = kd;
+    postCommand(Command::SetPositionGains, kp, kd);
     //LOG(Info) << "Set CM " << name() << " position gains to kp = " << kp << ", kd = " << kd << ".";
 }
 
 void CM::setForceRange(double min, double max) {
-    TASBI_LOCK
-    m_params.forceMin = min;
-    m_params.forceMax = max;
+    std::lock_guard<std::mutex> cmdLock(m_cmdMutex);
+    m_paramsRequested.forceMin = min;
+    m_paramsRequested.forceMax = max;
+    postCommand(Command::SetForceRange, min, max);
     //LOG(Info) << "Set CM " << name() << " force range to [ " << min << " , " << max << " N].";
 }
 
 void CM::setForceGains(double kp, double ki, double kd) {
-    TASBI_LOCK
-    m_params.forceKp = kp;
-    m_params.forceKi = ki;
-    m_params.forceKd = kd;
-    m_forcePd.kp = kp;
-    m_forcePd.kd = kd;
-
-    m_forcePID.setPID(kp,ki,kd);
+    std::lock_guard<std::mutex> cmdLock(m_cmdMutex);
+    m_paramsRequested.forceKp = kp;
+    m_paramsRequested.forceKi = ki;
+    m_paramsRequested.forceKd = kd;
+    postCommand(Command::SetForceGains, kp, ki, kd);
     //LOG(Info) << "Set CM " << name() << " force gains to kp = " << kp << ", kd = " << kd << ".";
 }
 
+void CM::setForceFeedForward(double kff) {
+    std::lock_guard<std::mutex> cmdLock(m_cmdMutex);
+    m_paramsRequested.forceKff = kff;
+    postCommand(Command::SetForceFeedForward, kff);
+}
+
 void CM::setForceFilterMode(FilterMode mode) {
-    TASBI_LOCK
-    m_forceFiltMode = mode;
+    std::lock_guard<std::mutex> cmdLock(m_cmdMutex);
+    postCommand(Command::SetForceFilterMode, mode);
 }
 
 void CM::setdFdtFilterMode(FilterMode mode) {
-    TASBI_LOCK
-    m_dFdtFiltMode = mode;
+    std::lock_guard<std::mutex> cmdLock(m_cmdMutex);
+    postCommand(Command::SetdFdtFilterMode, mode);
 }
 
 
 void CM::setControlMode(CM::ControlMode mode) {
-    TASBI_LOCK
-    m_ctrlMode  = mode;
-    m_ctrlValue = 0.0;
+    std::lock_guard<std::mutex> cmdLock(m_cmdMutex);
+    m_ctrlModeRequested = mode;
+    postCommand(Command::SetControlMode, mode);
     /* if (m_ctrlMode == ControlMode::Torque)
         LOG(Info) << "Set CM " << name() << " Control Mode to Torque.";
     else if (m_ctrlMode == ControlMode::Position)
@@ -412,102 +497,416 @@ void CM::setControlMode(CM::ControlMode mode) {
 }
 
 void CM::setControlValue(double value) {
-    TASBI_LOCK
-    if (m_ctrlMode == ControlMode::Torque){
-        if((m_ctrlValue<-1.0)||(m_ctrlValue>1.0)){
-            LOG(Warning) << "Control value " << m_ctrlValue <<" clamped by thresholds -1.0 and 1.0";
+    std::lock_guard<std::mutex> cmdLock(m_cmdMutex);
+    postCommand(Command::SetControlValue, clampControlValue(value));
+}
+
+double CM::clampControlValue(double value) {
+    if (m_ctrlModeRequested == ControlMode::Torque){
+        if((value<-1.0)||(value>1.0)){
+            AsyncLog::get().log(this, ClampTorqueLog, value);
         }
-        m_ctrlValue = clamp(value, -1.0, 1.0);
+        return clamp(value, -1.0, 1.0);
     }
     else{
-        if((m_ctrlValue<0.0)||(m_ctrlValue>1.0)){
-            LOG(Warning) << "Control value " << m_ctrlValue <<" clamped by thresholds 0.0 and 1.0";
+        if((value<0.0)||(value>1.0)){
+            AsyncLog::get().log(this, ClampLog, value);
         }
-        m_ctrlValue = clamp(value, 0.0, 1.0);
+        return clamp(value, 0.0, 1.0);
+    }
+}
+
+void CM::streamControlValue(double time, double value) {
+    std::lock_guard<std::mutex> cmdLock(m_cmdMutex);
+    postCommand(Command::StreamControlValue, time, clampControlValue(value));
+}
+
+void CM::streamControlValue(double value) {
+    streamControlValue(streamTime(), value);
+}
+
+double CM::streamTime() const {
+    return SetpointStream::clock() + m_streamOffset.load(std::memory_order_relaxed);
+}
+
+void CM::setStreamInterpolation(SetpointStream::Interpolation mode, double delay) {
+    std::lock_guard<std::mutex> cmdLock(m_cmdMutex);
+    postCommand(Command::SetStreamInterpolation, mode, delay);
+}
+
+std::uint64_t CM::queueSegment(Trajectory::Profile profile, double ref, double value) {
+    // the mapping from reference units to control value is linear, so speeds scale by its slope
+    double target = scaleRefToCtrlValue(ref);
+    if (profile == Trajectory::ConstantVelocity)
+        value = std::abs(scaleRefToCtrlValue(value) - scaleRefToCtrlValue(0));
+    std::lock_guard<std::mutex> cmdLock(m_cmdMutex);
+    double lo = m_ctrlModeRequested == ControlMode::Torque ? -1.0 : 0.0;
+    if ((target < lo) || (target > 1.0)) {
+        AsyncLog::get().log(this, ClampSegmentLog, target, lo);
     }
-    m_feedRate.tick();
+    target = clamp(target, lo, 1.0);
+    if (!postCommand(Command::QueueSegment, target, value, profile))
+        return 0;
+    return ++m_segmentsQueued;
+}
+
+void CM::clearTrajectory() {
+    std::lock_guard<std::mutex> cmdLock(m_cmdMutex);
+    postCommand(Command::ClearTrajectory);
+}
+
+bool CM::trajectoryDone(std::uint64_t seq) const {
+    return m_segmentsDone.load(std::memory_order_acquire) >= seq;
+}
+
+int CM::trajectoryPending() const {
+    std::lock_guard<std::mutex> cmdLock(m_cmdMutex);
+    return (int)(m_segmentsQueued - m_segmentsDone.load(std::memory_order_acquire));
+}
+
+void CM::setUserForceLimits(double min, double max) {
+    std::lock_guard<std::mutex> cmdLock(m_cmdMutex);
+    postCommand(Command::SetUserForceLimits, min, max);
+}
+
+void CM::setUserPositionLimits(double min, double max) {
+    std::lock_guard<std::mutex> cmdLock(m_cmdMutex);
+    postCommand(Command::SetUserPositionLimits, min, max);
+}
+
+int CM::getTripCause() const {
+    return m_tripCause.load(std::memory_order_acquire);
+}
+
+const char* CM::tripName(int cause) {
+    if (cause & Trip::VelocityLimit) return "Velocity Limit";
+    if (cause & Trip::TorqueLimit)   return "Torque Limit";
+    if (cause & Trip::ForceLimit)    return "Force Limit";
+    if (cause & Trip::PositionLimit) return "Position Limit";
+    return "None";
+}
+
+void CM::trip(int cause) {
+    m_tripCause.store(cause, std::memory_order_release);
+    if (is_enabled())
+        disable();
 }
 
 void CM::setForceFilter(double cutoff) {
-    TASBI_LOCK
     LOG(Info) << "Set CM " << name() << "force filter cutoff ratio to " << cutoff;
     // m_forceFilterL.configure(2, cutoff);
 }
 
 void CM::setdFdtFilter(double cutoff) {
-    TASBI_LOCK
+    std::lock_guard<std::mutex> cmdLock(m_cmdMutex);
+    m_paramsRequested.dFdtFilterCutoff = cutoff;
+    postParams(m_paramsRequested);
     LOG(Info) << "Set CM " << name() << "force derivative filter cutoff ratio to " << cutoff;
-    m_dFdtFilterL.configure(2, cutoff);
 }
 
 void CM::setControlValueFilter(double cutoff) {
-    TASBI_LOCK
+    std::lock_guard<std::mutex> cmdLock(m_cmdMutex);
+    m_paramsRequested.cvFilterCutoff = cutoff;
+    postParams(m_paramsRequested);
     LOG(Info) << "Set CM " << name() << " control value filter cutoff ratio to " << cutoff;
-    m_ctrlFilter.configure(2, cutoff);
 }
 
 void CM::enableControlValueFilter(bool enable) {
-    TASBI_LOCK
-    m_params.filterControlValue = enable;
-    LOG(Info) << (m_params.filterControlValue ? "Enabled" : "Disabled")
+    std::lock_guard<std::mutex> cmdLock(m_cmdMutex);
+    m_paramsRequested.filterControlValue = enable;
+    postCommand(Command::EnableControlValueFilter, 0, 0, 0, enable);
+    LOG(Info) << (enable ? "Enabled" : "Disabled")
               << " control value filtering on CM " << name() << ".";
 }
 
 void CM::setCustomController(std::shared_ptr<CMController> controller) {
+    TASBI_LOCK
     m_customController = controller;
+    resolveController();
 }
 
 void CM::getControllerIo(std::vector<double>& u, std::vector<double>& y) {
-    TASBI_LOCK
-    std::size_t avail = m_Q.size();
+    std::vector<Query> Q;
+    m_Q.snapshot(Q);
+    std::size_t avail = std::min({Q.size(), u.size(), y.size()});
     for (std::size_t i = 0; i < avail; ++i) {
-        u[i] = m_Q[i].ctrlValueScaled;
-        y[i] = m_Q[i].spoolPosition;
+        u[i] = Q[i].ctrlValueScaled;
+        y[i] = Q[i].spoolPosition;
     }
 }
 
 void CM::getFilterIo(std::vector<double>& u, std::vector<double>& y) {
-    TASBI_LOCK
-    std::size_t avail = m_Q.size();
+    std::vector<Query> Q;
+    m_Q.snapshot(Q);
+    std::size_t avail = std::min({Q.size(), u.size(), y.size()});
     for (std::size_t i = 0; i < avail; ++i) {
-        u[i] = m_Q[i].force;
-        y[i] = m_Q[i].forceFiltered;
+        u[i] = Q[i].force;
+        y[i] = Q[i].forceFiltered;
     }
 }
 
+std::size_t CM::readQueries(std::uint64_t& cursor, std::vector<Query>& out) const {
+    return m_Q.read_since(cursor, out);
+}
+
 //=============================================================================
 // PRIVATE (NOT THREAD SAFE)
 //=============================================================================
 
+bool CM::postCommand(Command::Type type, double a, double b, double c, bool flag) {
+    Command cmd;
+    cmd.type = type;
+    cmd.a    = a;
+    cmd.b    = b;
+    cmd.c    = c;
+    cmd.flag = flag;
+    if (!m_commands.push(cmd)) {
+        AsyncLog::get().log(this, DroppedCommandLog, name(), ++m_droppedCommands);
+        return false;
+    }
+    return true;
+}
+
+CM::PreparedParams::PreparedParams(const Params& p) :
+    params(p),
+    ctrlCoeffs(Biquad::butterworth(p.cvFilterCutoff)),
+    dFdtCoeffs(Biquad::butterworth(p.dFdtFilterCutoff)),
+    outputCoeffs(Biquad::butterworth(p.outputFilterCutoff)),
+    velocityCoeffs(Biquad::butterworth(p.velFilterCutoff)),
+    medians{MedianStage(p.forceFilterN), MedianStage(p.forceFilterN),
+            MedianStage(p.forceFilterN), MedianStage(p.forceFilterN)},
+    averages{AverageStage(p.forceFilterAvgN), AverageStage(p.forceFilterAvgN)}
+{ }
+
+void CM::postParams(const Params& params) {
+    freeRetiredParams();
+    Command cmd;
+    cmd.type     = Command::SetParams;
+    cmd.prepared = new PreparedParams(params);
+    if (!m_commands.push(cmd)) {
+        delete cmd.prepared;
+        AsyncLog::get().log(this, DroppedCommandLog, name(), ++m_droppedCommands);
+    }
+}
+
+void CM::applyParams(PreparedParams& prepared) {
+    m_params = prepared.params;
+    m_io.encoderCh.set_units(m_params.degPerCount);
+    m_positionPd.kp = m_params.positionKp;
+    m_positionPd.kd = m_params.positionKd;
+    m_forcePd.kp = m_params.forceKp;
+    m_forcePd.kd = m_params.forceKd;
+    m_forcePID.setPID(m_params.forceKp, m_params.forceKi, m_params.forceKd);
+    // all filters are 2nd order sections, so only coefficients change and state is kept
+    m_ctrlFilter.set_coefficients(prepared.ctrlCoeffs);
+    // m_forceFilter.for_each<LowpassStage>(... Biquad::butterworth(m_params.forceFilterCutoff) ...);
+    m_dFdtFilter.for_each<LowpassStage>([&](LowpassStage& f) { f.set_coefficients(prepared.dFdtCoeffs); });
+    m_outputFilter.set_coefficients(prepared.outputCoeffs);
+    m_velocityFilter.set_coefficients(prepared.velocityCoeffs);
+    // windowed stages only change topology when their length does; the old
+    // buffers go back with the prepared set to be freed off the control thread
+    std::size_t m = 0, a = 0;
+    auto swapMedian = [&](MedianStage& f) {
+        if (f.size() != prepared.medians[m].size())
+            std::swap(f, prepared.medians[m]);
+        ++m;
+    };
+    auto swapAverage = [&](AverageStage& f) {
+        if (f.size() != prepared.averages[a].size())
+            std::swap(f, prepared.averages[a]);
+        ++a;
+    };
+    m_forceFilter.for_each<MedianStage>(swapMedian);
+    m_dFdtFilter.for_each<MedianStage>(swapMedian);
+    m_forceFilter.for_each<AverageStage>(swapAverage);
+    m_dFdtFilter.for_each<AverageStage>(swapAverage);
+}
+
+void CM::freeRetiredParams() {
+    PreparedParams* prepared;
+    while (m_retired.pop(prepared))
+        delete prepared;
+}
+
+void CM::drainCommands() {
+    Command cmd;
+    while (m_commands.pop(cmd)) {
+        applyCommand(cmd);
+        if (cmd.type != Command::SetControlValue && cmd.type != Command::QueueSegment && cmd.type != Command::ClearTrajectory &&
+            cmd.type != Command::StreamControlValue && cmd.type != Command::SetStreamInterpolation)
+            m_configVersion++;
+    }
+}
+
+void CM::applyCommand(const Command& cmd) {
+    switch (cmd.type) {
+        case Command::SetControlValue:
+            dropTrajectory();
+            m_stream.clear();
+            m_ctrlValue = cmd.a;
+            m_feedRate.tick();
+            break;
+        case Command::SetControlMode:
+            dropTrajectory();
+            m_stream.clear();
+            m_ctrlMode  = (ControlMode)(int)cmd.a;
+            m_ctrlValue = 0.0;
+            resolveController();
+            break;
+        case Command::SetPositionRange:
+            m_params.positionMin = cmd.a;
+            m_params.positionMax = cmd.b;
+            break;
+        case Command::SetPositionGains:
+            m_params.positionKp = cmd.a;
+            m_params.positionKd = cmd.b;
+            m_positionPd.kp     = cmd.a;
+            m_positionPd.kd     = cmd.b;
+            break;
+        case Command::SetForceRange:
+            m_params.forceMin = cmd.a;
+            m_params.forceMax = cmd.b;
+            break;
+        case Command::SetForceGains:
+            m_params.forceKp = cmd.a;
+            m_params.forceKi = cmd.b;
+            m_params.forceKd = cmd.c;
+            m_forcePd.kp     = cmd.a;
+            m_forcePd.kd     = cmd.c;
+            m_forcePID.setPID(cmd.a, cmd.b, cmd.c);
+            break;
+        case Command::SetForceFeedForward:
+            m_params.forceKff = cmd.a;
+            break;
+        case Command::SetVelocityMax:
+            m_params.velocityMax         = cmd.a;
+            m_params.has_velocity_limit_ = cmd.flag;
+            break;
+        case Command::SetTorqueMax:
+            m_params.torqueMax         = cmd.a;
+            m_params.has_torque_limit_ = cmd.flag;
+            break;
+        case Command::SetForceFilterMode:
+            m_forceFilter.select((int)cmd.a);
+            break;
+        case Command::SetdFdtFilterMode:
+            m_dFdtFilter.select((int)cmd.a);
+            break;
+        case Command::SetParams:
+            applyParams(*cmd.prepared);
+            resolveController();
+            // hand the (now stale) buffers back so they are freed off the control thread
+            if (!m_retired.push(cmd.prepared))
+                delete cmd.prepared;
+            break;
+        case Command::EnableControlValueFilter:
+            m_params.filterControlValue = cmd.flag;
+            break;
+        case Command::SetPosCmdSign:
+            m_params.posCmdSignFlip = cmd.flag;
+            resolveController();
+            break;
+        case Command::SetForceCmdSign:
+            m_params.forceCmdSignFlip = cmd.flag;
+            resolveController();
+            break;
+        case Command::SetPosSenseSign:
+            m_params.posSenseSignFlip = cmd.flag;
+            break;
+        case Command::SetForceSenseSign:
+            m_params.forceSenseSignFlip = cmd.flag;
+            break;
+        case Command::ZeroForce:
+            m_io.forceCh.zero();
+            break;
+        case Command::QueueSegment: {
+            Trajectory::Segment segment;
+            segment.profile  = (Trajectory::Profile)(int)cmd.c;
+            segment.target   = cmd.a;
+            segment.duration = cmd.b;
+            segment.speed    = cmd.b;
+            m_stream.clear();
+            // a full trajectory drops the segment, which counts as finished so pollers move on
+            if (!m_trajectory.push(segment))
+                m_segmentsDone.fetch_add(1, std::memory_order_release);
+            break;
+        }
+        case Command::ClearTrajectory:
+            dropTrajectory();
+            break;
+        case Command::StreamControlValue: {
+            dropTrajectory();
+            SetpointStream::Sample sample;
+            sample.time  = cmd.a;
+            sample.value = cmd.b;
+            m_stream.push(sample);
+            m_feedRate.tick();
+            break;
+        }
+        case Command::SetStreamInterpolation:
+            m_stream.configure((SetpointStream::Interpolation)(int)cmd.a, cmd.b);
+            break;
+        case Command::SetUserForceLimits:
+            m_userForceMin = cmd.a;
+            m_userForceMax = cmd.b;
+            break;
+        case Command::SetUserPositionLimits:
+            m_userPositionMin = cmd.a;
+            m_userPositionMax = cmd.b;
+            break;
+    }
+}
+
+void CM::dropTrajectory() {
+    if (m_trajectory.active())
+        m_segmentsDone.fetch_add(m_trajectory.clear(), std::memory_order_release);
+}
+
 void CM::controlUpdate(double ctrlValue) {
-    if (m_ctrlMode == ControlMode::Torque) {
-        double torque = scaleCtrlValue(ctrlValue, ControlMode::Torque);
-        setMotorTorque(torque);
-    } else if (m_ctrlMode == ControlMode::Position) {
-        double position = scaleCtrlValue(ctrlValue, ControlMode::Position);
-        controlSpoolPosition(position);
-    } else if (m_ctrlMode == ControlMode::Force) {
-        double force = scaleCtrlValue(ctrlValue, ControlMode::Force);
-        controlForce(force);
-    } else if (m_ctrlMode == ControlMode::ForceHybrid) {
-        double force = scaleCtrlValue(ctrlValue, ControlMode::Force);
-        controlForceHybrid(force);
-    } else if (m_ctrlMode == ControlMode::Custom) {
-        m_customController->update(ctrlValue, m_t, *this);
+    std::visit([this, ctrlValue](const auto& loop) { runLoop(loop, ctrlValue); }, m_controller);
+}
+
+void CM::resolveController() {
+    m_configVersion++;
+    switch (m_ctrlMode) {
+        case ControlMode::Position:    m_controller = PositionLoop();    break;
+        case ControlMode::Force:       m_controller = ForceLoop();       break;
+        case ControlMode::ForceHybrid: m_controller = ForceHybridLoop(); break;
+        case ControlMode::Custom:      m_controller = CustomLoop{m_customController.get()}; break;
+        default:                       m_controller = TorqueLoop();      break;
     }
+    if (m_ctrlMode == ControlMode::Position)
+        m_cmdSign = m_params.posCmdSignFlip ? -1.0 : 1.0;
+    else
+        m_cmdSign = m_params.forceCmdSignFlip ? -1.0 : 1.0;
+}
+
+void CM::runLoop(const TorqueLoop&, double ctrlValue) {
+    setMotorTorque(scaleCtrlValue(ctrlValue, ControlMode::Torque));
+}
+
+void CM::runLoop(const PositionLoop&, double ctrlValue) {
+    controlSpoolPosition(scaleCtrlValue(ctrlValue, ControlMode::Position));
+}
+
+void CM::runLoop(const ForceLoop&, double ctrlValue) {
+    controlForce(scaleCtrlValue(ctrlValue, ControlMode::Force));
+}
+
+void CM::runLoop(const ForceHybridLoop&, double ctrlValue) {
+    controlForceHybrid(scaleCtrlValue(ctrlValue, ControlMode::Force));
+}
+
+void CM::runLoop(const CustomLoop& loop, double ctrlValue) {
+    if (loop.controller)
+        loop.controller->update(ctrlValue, m_t, *this);
 }
 
 void CM::setMotorTorque(double torque) {
     if (m_params.filterOutputValue)
         torque = m_outputFilter.update(torque);
-    double commandSign;
-    if (m_ctrlMode == ControlMode::Position){
-        commandSign = m_params.posCmdSignFlip ? -1.0 : 1.0;
-    }else{
-        commandSign = m_params.forceCmdSignFlip ? -1.0 : 1.0;
-    }
     m_torque = torque;
-    double amps = torque*commandSign / m_params.motorTorqueConstant;
+    double amps = torque*m_cmdSign / m_params.motorTorqueConstant;
     double volts = amps / m_params.commandGain;
     m_io.commandCh.set_volts(volts);
 }
@@ -563,116 +962,93 @@ void CM::onUpdate() {
     // do nothing by default
 }
 
+void CM::acquire(const Time& t) {
+    // encoder
+    m_velocityFilter.update(senseEncoder(t));
+    senseVelocity(m_velocityFilter.get_value());
+    // force
+    m_sample.forceFiltered = m_forceFilter.filter(senseForce());
+    // force derivative
+    m_sample.dFdtFiltered  = m_dFdtFilter.filter(differentiateForce(t));
+}
+
+double CM::senseEncoder(const Time& t) {
+    double posSign = m_params.posSenseSignFlip ? -1.0 : 1.0;
+    m_sample.counts          = posSign*m_io.encoderCh.get_counts();
+    m_sample.countsPerSecond = posSign*(*m_io.cps);
+    m_sample.motorPosition   = posSign*m_io.encoderCh.get_pos();
+    return m_posDiff.update(m_sample.motorPosition, t);
+}
+
+void CM::senseVelocity(double filtered) {
+    double posSign = m_params.posSenseSignFlip ? -1.0 : 1.0;
+    double vel = m_params.useSoftwareVelocity ? filtered : *m_io.vel;
+    m_sample.motorVelocity   = posSign*vel;
+}
+
+double CM::senseForce() {
+    double forceSign = m_params.forceSenseSignFlip ? -1.0 : 1.0;
+    m_sample.force = forceSign*m_io.forceCh.get_force(m_io.forceaxis);
+    return m_sample.force;
+}
+
+double CM::differentiateForce(const Time& t) {
+    m_forceDiff.update(m_sample.forceFiltered, t);
+    m_sample.dFdt = m_forceDiff.get_value();
+    return m_sample.dFdt;
+}
+
 int32 CM::getEncoderCounts() {
-    double senseSign = m_params.posSenseSignFlip ? -1.0 : 1.0;
-    return senseSign*m_io.encoderCh.get_counts();
+    return onControlThread() ? m_sample.counts : m_qPublished.load().counts;
 }
 
 double CM::getEncoderCountsPerSecond() {
-    double senseSign = m_params.posSenseSignFlip ? -1.0 : 1.0;
-    return *m_io.cps*senseSign;
+    return onControlThread() ? m_sample.countsPerSecond : m_qPublished.load().countsPerSecond;
 }
 
 double CM::getMotorTorqueCommand() {
     double volts = m_io.commandCh.get_volts();
-    double commandSign;
-    if (m_ctrlMode == ControlMode::Position){
-        commandSign = m_params.posCmdSignFlip ? -1.0 : 1.0;
-    }else{
-        commandSign = m_params.forceCmdSignFlip ? -1.0 : 1.0;
-    }
-    double amps = volts * m_params.commandGain*commandSign;
+    double amps = volts * m_params.commandGain*m_cmdSign;
     return amps * m_params.motorTorqueConstant;
 }
 
 double CM::getMotorPosition() { 
-    double senseSign = m_params.posSenseSignFlip ? -1.0 : 1.0;
-    double pp = senseSign*m_io.encoderCh.get_pos();
-    //std::cout << "senseSign" << senseSign << "enc pos" << m_io.encoderCh.get_pos() << "adjusted pos" << pp << std::endl;
-
-    // if(pp == 0) {
-    //     LOG(Warning) << "motor position is not recorded for cm " << name();
-    // }
-    return pp;
+    return onControlThread() ? m_sample.motorPosition : m_qPublished.load().motorPosition;
 }
 
 double CM::getMotorVelocity() { 
-    double senseSign = m_params.posSenseSignFlip ? -1.0 : 1.0;
-    double vel =  m_params.useSoftwareVelocity ? m_velocityFilter.get_value() : *m_io.vel; 
-    //std::cout << "senseSign" << senseSign << "enc vel" << vel << "adjusted vel" << senseSign*vel << std::endl;
-    return senseSign*vel;
+    return onControlThread() ? m_sample.motorVelocity : m_qPublished.load().motorVelocity;
 }
 
 double CM::getSpoolPosition() { 
-    double pp = getMotorPosition() * m_params.gearRatio;
-    // if(abs(pp) < 1e-100) {
-    //     LOG(Warning) << "Spool position is not recorded for cm " << name();
-    // } 
-    return pp; 
-}
-
-double CM::getSpoolVelocity() { return getMotorVelocity() * m_params.gearRatio; }
-
-double CM::getForce(bool filtered, bool forUpdate) {
-    double senseSign = m_params.forceSenseSignFlip ? -1.0 : 1.0;
-    double raw = senseSign*m_io.forceCh.get_force(m_io.forceaxis);
-    if(forUpdate ==1){
-        if (!filtered)
-            return raw;
-        switch(m_forceFiltMode) {
-            case None:    return raw;
-            case Lowpass: m_forceFilterL.update(raw);
-            case Median:  m_forceFilterM.filter(raw);
-            case Cascade: m_forceFilterL.update(m_forceFilterM.filter(raw));
-            default:      raw = raw;
-        }
-    }
-
-    if (!filtered)
-        return raw;
-    switch(m_forceFiltMode) {
-        case None:    return raw;
-        case Lowpass: return m_forceFilterL.get_value();
-        case Median:  return m_forceFilterM.get_value();
-        case Cascade: return m_forceFilterL.get_value();
-        default:      return raw;
-    }
+    return onControlThread() ? m_sample.motorPosition * m_params.gearRatio : m_qPublished.load().spoolPosition;
+}
 
+double CM::getSpoolVelocity() {
+    return onControlThread() ? m_sample.motorVelocity * m_params.gearRatio : m_qPublished.load().spoolVelocity;
 }
 
-double CM::getdFdt(bool filtered, bool forUpdate) {
-    double raw;
-    if(forUpdate ==1){
-        m_forceDiff.update(getForce(), m_t);
-        raw = m_forceDiff.get_value();
-        if (!filtered)
-            return raw;
-        switch(m_dFdtFiltMode) {
-            case None:    return raw;
-            case Lowpass: m_dFdtFilterL.update(raw);
-            case Median:  m_dFdtFilterM.filter(raw);
-            case Cascade: m_dFdtFilterL.update(m_dFdtFilterM.filter(raw));
-            default:      return raw;
-        }
+double CM::getForce(bool filtered) {
+    if (!onControlThread()) {
+        Query q = m_qPublished.load();
+        return filtered ? q.forceFiltered : q.force;
     }
-    
-    raw = m_forceDiff.get_value();
-    if (!filtered)
-        return raw;
-    switch(m_dFdtFiltMode) {
-        case None:    return raw;
-        case Lowpass: return m_dFdtFilterL.get_value();
-        case Median:  return m_dFdtFilterM.get_value();
-        case Cascade: return m_dFdtFilterL.get_value();
-        default:      return raw;
+    return filtered ? m_sample.forceFiltered : m_sample.force;
+}
+
+double CM::getdFdt(bool filtered) {
+    if (!onControlThread()) {
+        Query q = m_qPublished.load();
+        return filtered ? q.dFdtFiltered : q.dFdt;
     }
+    return filtered ? m_sample.dFdtFiltered : m_sample.dFdt;
 }
 
 bool CM::velocity_limit_exceeded() {
     double m_velocity = getMotorVelocity();
     bool exceeded = false;
     if (m_params.has_velocity_limit_ && abs(m_velocity) > m_params.velocityMax) {
-        LOG(Error) << "Capstan Module " << name() << " velocity exceeded the velocity limit " << m_params.velocityMax << " deg/s with a value of " << m_velocity << " deg/s.";
+        AsyncLog::get().log(this, VelocityLimitLog, name(), m_params.velocityMax, m_velocity);
         exceeded = true;
         on_disable();
     }
@@ -683,7 +1059,7 @@ bool CM::torque_limit_exceeded() {
     bool exceeded = false;
     double torque = getMotorTorqueCommand();
     if (m_params.has_torque_limit_ && abs(torque) > m_params.torqueMax) {
-        LOG(Error) << "Capstan Module " << name() << " command torque exceeded the torque limit " << m_params.torqueMax << " Nm with a value of " << torque << " Nm.";
+        AsyncLog::get().log(this, TorqueLimitLog, name(), m_params.torqueMax, torque);
         exceeded = true;
         on_disable();
     }
@@ -696,30 +1072,31 @@ void CM::limits_exceeded(){
 }
 
 double CM::scaleRefToCtrlValue(double ref) {
-    TASBI_LOCK
+    std::lock_guard<std::mutex> cmdLock(m_cmdMutex);
+    const Params& p = m_paramsRequested;
 
-    if (m_ctrlMode == ControlMode::Torque){
-         double cv = (ref + m_params.torqueMax)/(2*m_params.torqueMax);
-         LOG(Info) << "Reference value " << ref << " Nm for CM " << name() << " converted to " << cv << " for torque control.";
+    if (m_ctrlModeRequested == ControlMode::Torque){
+         double cv = (ref + p.torqueMax)/(2*p.torqueMax);
+         AsyncLog::get().log(this, ScaleTorqueLog, ref, name(), cv);
          return cv;
     }
-    else if (m_ctrlMode == ControlMode::Position){
-         double cv = (ref - m_params.positionMin)/(m_params.positionMax - m_params.positionMin);
+    else if (m_ctrlModeRequested == ControlMode::Position){
+         double cv = (ref - p.positionMin)/(p.positionMax - p.positionMin);
          //LOG(Info) << "Reference value " << ref << " deg for CM " << name() << " converted to " << cv << " for position control.";
          return cv;
     }
-    else if (m_ctrlMode == ControlMode::Force){
-         double cv = (ref - m_params.forceMin)/(m_params.forceMax - m_params.forceMin);
+    else if (m_ctrlModeRequested == ControlMode::Force){
+         double cv = (ref - p.forceMin)/(p.forceMax - p.forceMin);
          //LOG(Info) << "Reference value " << ref << " N for CM " << name() << " converted to " << cv << " for force control.";
          return cv;
     }
-    else if (m_ctrlMode == ControlMode::ForceHybrid){
-         double cv = (ref - m_params.forceMin)/(m_params.forceMax - m_params.forceMin);
+    else if (m_ctrlModeRequested == ControlMode::ForceHybrid){
+         double cv = (ref - p.forceMin)/(p.forceMax - p.forceMin);
          //LOG(Info) << "Reference value " << ref << " N for CM " << name() << " converted to " << cv << " for force 2 control.";
          return cv;
     }
-    else
-        LOG(Info) << "Control scheme not found for scaling control reference value" << " ].";
+    AsyncLog::get().log(ScaleUnknownLog);
+    return 0;
 }
 
 double CM::scaleCtrlValue(double ctrlValue, ControlMode mode) {
@@ -737,6 +1114,7 @@ double CM::scaleCtrlValue(double ctrlValue, ControlMode mode) {
 
 bool CM::on_enable() {
     TASBI_LOCK
+    m_tripCause = Trip::NoTrip;
     m_io.commandCh.set_volts(0.0);
     if (m_io.enableCh.write_high()) {
         m_status = Status::Enabled;
@@ -757,21 +1135,29 @@ bool CM::on_disable() {
 
 void CM::fillQuery(CM::Query &q) {
     q.status             = m_status;
-    q.counts             = getEncoderCounts();
-    q.countsPerSecond    = getEncoderCountsPerSecond();
-    q.motorPosition      = getMotorPosition();
-    q.motorVelocity      = getMotorVelocity();
+    q.counts             = m_sample.counts;
+    q.countsPerSecond    = m_sample.countsPerSecond;
+    q.motorPosition      = m_sample.motorPosition;
+    q.motorVelocity      = m_sample.motorVelocity;
     q.motorTorqueCommand = getMotorTorqueCommand();
-    q.spoolPosition      = getSpoolPosition();
-    q.spoolVelocity      = getSpoolVelocity();
-    q.force              = getForce(false);
-    q.forceFiltered      = getForce(true);
+    q.spoolPosition      = m_sample.motorPosition * m_params.gearRatio;
+    q.spoolVelocity      = m_sample.motorVelocity * m_params.gearRatio;
+    q.force              = m_sample.force;
+    q.forceFiltered      = m_sample.forceFiltered;
     q.ctrlMode           = m_ctrlMode;
-    q.filtMode           = m_forceFiltMode;
+    q.filtMode           = m_forceFilter.selected();
     q.ctrlValue          = m_ctrlValue;
     q.ctrlValueFiltered  = m_ctrlValueFiltered;
     q.ctrlValueScaled    = m_params.filterControlValue ? scaleCtrlValue(m_ctrlValueFiltered, m_ctrlMode) : scaleCtrlValue(m_ctrlValue, m_ctrlMode);
     q.lockCount = m_lockCount;
     q.feedRate  = m_feedRate.rate();
-    q.dFdt      = m_forceDiff.get_value();
+    q.feedInterval    = m_stream.jitter().interval * 1e3;
+    q.feedJitter      = m_stream.jitter().stdDev * 1e3;
+    q.feedIntervalMax = m_stream.jitter().max * 1e3;
+    q.feedStarved     = m_stream.jitter().starved;
+    q.dFdt      = m_sample.dFdt;
+    q.dFdtFiltered = m_sample.dFdtFiltered;
+    q.queryRetries = (int)m_qPublished.retries();
+    q.tripCause = m_tripCause.load(std::memory_order_relaxed);
+    q.droppedCommands = m_droppedCommands.load(std::memory_order_relaxed);
 }
@@ -26,11 +26,22 @@
 #include <Mahi/Util.hpp>
 #include <Mahi/Util/Coroutine.hpp>
 
+#include <array>
+#include <atomic>
 #include <mutex>
+#include <thread>
+#include <variant>
 
+#include "Util/Biquad.hpp"
+#include "Util/FilterChain.hpp"
 #include "Util/RateMonitor.hpp"
 #include "Util/MedianFilter.hpp"
 #include "Util/MiniPID.hpp"
+#include "Util/Seqlock.hpp"
+#include "Util/SetpointStream.hpp"
+#include "Util/SpscQueue.hpp"
+#include "Util/TelemetryRing.hpp"
+#include "Util/Trajectory.hpp"
 
 // Written by Janelle Clark with Nathan Dunkelberger, based off code by Evan Pezent
 
@@ -39,8 +50,10 @@
 #define TASBI_LOCK                                                                                 \
     std::lock_guard<std::mutex> lock(m_mutex);                                                     \
     m_lockCount++;
+#define TASBI_UPDATE_LOCK std::lock_guard<std::mutex> lock(m_mutex);
 #else
 #define TASBI_LOCK
+#define TASBI_UPDATE_LOCK
 #endif
 
 using mahi::daq::AIHandle;
@@ -58,6 +71,7 @@ using mahi::util::Differentiator;
 using mahi::util::RingBuffer;
 
 class CM;
+class CMBank;
 
 struct CMController {
     virtual ~CMController()                                { }
@@ -65,6 +79,7 @@ struct CMController {
 };
 
 class CM : public mahi::util::Device {
+    friend class CMBank;
 public:
     /// State
     enum Status : int {
@@ -81,12 +96,22 @@ public:
         Custom      = 5   ///< custom controller
     };
 
+    /// Supervisor trip causes (bits)
+    enum Trip : int {
+        NoTrip        = 0,
+        VelocityLimit = 1,  ///< |motor velocity| above velocityMax
+        TorqueLimit   = 2,  ///< |torque command| above torqueMax
+        ForceLimit    = 4,  ///< force outside the user force limits
+        PositionLimit = 8   ///< spool position outside the user position limits
+    };
+
     /// Force Filter Type
     enum FilterMode : int {
         None    = 0,
         Lowpass = 1,
         Median  = 2,
-        Cascade = 3
+        Cascade = 3,
+        Average = 4
     };
 
     /// CM IO Configuration
@@ -134,6 +159,7 @@ public:
         double forceFilterCutoff   = 2000;        
         double dFdtFilterCutoff   = 0.25;        
         int    forceFilterN        = 31;  
+        int    forceFilterAvgN     = 21;             // moving average window [samples]
         double cvFilterCutoff      = 0.02;           // normalized [0,1]
         bool   filterControlValue  = false;           // [true/false]
         double outputFilterCutoff  = 0.2;            //0.2
@@ -142,6 +168,18 @@ public:
         bool   useSoftwareVelocity = false;
     };
 
+    /// Sensor values acquired once at the start of each update
+    struct Sample {
+        int    counts          = 0;  ///< encoder counts (sign corrected)
+        double countsPerSecond = 0;  ///< encoder counts/s (sign corrected)
+        double motorPosition   = 0;  ///< [deg]
+        double motorVelocity   = 0;  ///< [deg/s]
+        double force           = 0;  ///< raw force [N]
+        double forceFiltered   = 0;  ///< force through the selected filter [N]
+        double dFdt            = 0;  ///< raw force derivative [N/s]
+        double dFdtFiltered    = 0;  ///< force derivative through the selected filter [N/s]
+    };
+
     /// CM Query
     struct Query {
         int         time               = 0;
@@ -162,7 +200,15 @@ public:
         double      ctrlValueScaled    = 0;
         int         lockCount          = 0;
         double      feedRate           = 0;
+        double      feedInterval       = 0;  ///< [ms] mean time between streamed setpoints
+        double      feedJitter         = 0;  ///< [ms] standard deviation of the time between streamed setpoints
+        double      feedIntervalMax    = 0;  ///< [ms] longest time between streamed setpoints
+        double      feedStarved        = 0;  ///< fraction of ticks past the newest streamed setpoint
         double      dFdt               = 0;
+        double      dFdtFiltered       = 0;
+        int         queryRetries       = 0;
+        int         tripCause          = Trip::NoTrip;
+        int         droppedCommands    = 0;  ///< commands and params lost to a full command queue
     };
 
 //----------------------------------------------------------------------------------
@@ -175,7 +221,7 @@ public:
     ~CM();
     /// Updates the CM device (thread safe)
     void update(const mahi::util::Time &t);
-    /// Configures a CM (thread safe)
+    /// Configures a CM; filters are designed on the calling thread and swapped in at the next tick (thread safe)
     void setParams(Params params);
     /// Exports configuration to JSON (thread safe)
     bool exportParams(const std::string& filepath);
@@ -183,9 +229,9 @@ public:
     bool importParams(const std::string& filepath);
     /// Gets a CM configuration (thread safe)
     Params getParams() const;
-    /// Queries CM for full state information (thread safe)
+    /// Queries CM for full state information (thread safe, lock-free unless immediate)
     Query getQuery(bool immediate = false);
-    /// Get most recent 10k Queries. WILL TEMPORAIRLY STALL CONTROLLER (thread safe)
+    /// Writes most recent 10k Queries to CSV without stalling the controller (thread safe)
     void dumpQueries(const std::string& filepath);
     /// Set boolean to flip command current for position control if necessary
     void setPosCtrlCmdSign(bool cmdSignFlip);
@@ -205,6 +251,14 @@ public:
     void setVelocityMax(double vel, bool has_limit_);
     /// Sets torque limit (thread safe)
     void setTorqueMax(double tor, bool has_limit_);
+    /// Sets the subject force limits [N] the CMHub supervisor disables outside of (thread safe)
+    void setUserForceLimits(double min, double max);
+    /// Sets the subject spool position limits the CMHub supervisor disables outside of (thread safe)
+    void setUserPositionLimits(double min, double max);
+    /// Returns the Trip bits that last disabled this CM, NoTrip since it was enabled (thread safe)
+    int getTripCause() const;
+    /// Name of the lowest Trip bit in cause
+    static const char* tripName(int cause);
     /// Sets position control range (thread safe)
     void setPositionRange(double min, double max);
     /// Sets spool position control PD gains (thread safe)
@@ -213,6 +267,8 @@ public:
     void setForceRange(double min, double max);
     /// Sets spool position control PD gains (thread safe)
     void setForceGains(double kp, double ki, double kd);
+    /// Sets the force control feedforward gain (thread safe)
+    void setForceFeedForward(double kff);
     /// Sets the normalize cutoff ratio of the force filter (thead safe)
     void setForceFilter(double cutoff);
     /// Sets the normalize cutoff ratio of the force derivative filter (thead safe)
@@ -225,6 +281,25 @@ public:
     void setControlMode(ControlMode mode);
     /// Sets the normalized value [-1 to 1] for torque or [0 to 1] for position/force (thread safe)
     void setControlValue(double value);
+    /// Streams a control value stamped time [s on streamTime()]. The control thread interpolates the
+    /// stream at its own tick time minus the stream delay, so bursty producers do not add jitter (thread safe)
+    void streamControlValue(double time, double value);
+    /// Streams a control value stamped streamTime() (thread safe)
+    void streamControlValue(double value);
+    /// Returns now on the control thread's tick clock [s], the time base for streamed values (thread safe)
+    double streamTime() const;
+    /// Sets how streamed control values are interpolated and how far behind the newest one they are played [s] (thread safe)
+    void setStreamInterpolation(SetpointStream::Interpolation mode, double delay);
+    /// Queues a trajectory segment to ref (in the units of the requested control mode) that the control
+    /// thread plays back every tick. value is the duration [s] for Linear, MinJerk and Hold, or the speed
+    /// [units/s] for ConstantVelocity. Returns the segment's sequence number, 0 if it was dropped (thread safe)
+    std::uint64_t queueSegment(Trajectory::Profile profile, double ref, double value);
+    /// Drops queued segments and holds the current setpoint. setControlValue, streamControlValue and setControlMode also do this (thread safe)
+    void clearTrajectory();
+    /// Returns true once segment seq has finished or been dropped (thread safe)
+    bool trajectoryDone(std::uint64_t seq) const;
+    /// Number of queued segments that have not finished (thread safe)
+    int trajectoryPending() const;
     /// Sets the normalized cutoff ratio of the control filter
     void setControlValueFilter(double cutoff);
     /// Enables/Disables control value filtering (thread safe)
@@ -235,21 +310,23 @@ public:
     void getControllerIo(std::vector<double>& u, std::vector<double>& y);
     /// Copies filter input/output history to buffers (thread safe)
     void getFilterIo(std::vector<double>& u, std::vector<double>& y);
+    /// Copies Queries published since cursor to out and advances cursor (thread safe)
+    std::size_t readQueries(std::uint64_t& cursor, std::vector<Query>& out) const;
 
 //----------------------------------------------------------------------------------
 // UNSAFE FUNCTIONS (ONLY CALL THESE FROM WITHIN A TASBI CONTROLLER UPDATE METHOD)
 //----------------------------------------------------------------------------------
 
     /// The control update (passed normalized control value) (DO NOT LOCK)
-    virtual void controlUpdate(double ctrlValue);
+    void controlUpdate(double ctrlValue);
     /// Implements motor position controller (DO NOT LOCK)
-    virtual void controlMotorPosition(double degrees);
+    void controlMotorPosition(double degrees);
     /// Implements spool position controller (DO NOT LOCK)
-    virtual void controlSpoolPosition(double degrees);
+    void controlSpoolPosition(double degrees);
     /// Implements force controller (DO NOT LOCK)
-    virtual void controlForce(double newtons);
+    void controlForce(double newtons);
     /// Implements hybrid force control with velocity instead of dF (DO NOT LOCK)
-    virtual void controlForceHybrid(double newtons);
+    void controlForceHybrid(double newtons);
     /// Called inside of update after controlUpdate (does nothing by default) (DO NOT LOCK)
     virtual void onUpdate();
 
@@ -257,6 +334,11 @@ public:
     void setMotorTorque(double torque);
     /// Returns the commanded motor torque in [Nm]
     double getMotorTorqueCommand();
+    /// Reads every sensor once and runs the input filters; the getters below return these values
+    void acquire(const mahi::util::Time &t);
+    /// The sensor getters below return this tick's values on the thread updating the CM.
+    /// Called from any other thread (e.g. a GUI) they return the values last published
+    /// with the Query instead, so they are safe there but lag by up to a telemetry tick.
     /// Returns counts of motor encoder
     int getEncoderCounts();
     /// Returns the motor encoder speed
@@ -270,9 +352,9 @@ public:
     /// Returns the spool velocity in [deg/s]
     double getSpoolVelocity();
     /// Returns the force sensor reading in [N]
-    virtual double getForce(bool filtered = true, bool forUpdate = false);
+    double getForce(bool filtered = true);
     /// Returns the derivative of the force sensor reading in [N/s]
-    virtual double getdFdt(bool filtered = true, bool forUpdate = false);
+    double getdFdt(bool filtered = true);
     /// Ensures the velocity does not exceed the velocity limit
     bool velocity_limit_exceeded();
     /// Ensures the torque does not exceed the torque limit
@@ -282,7 +364,7 @@ public:
     /// Convert control reference value for to the normalized value [-1 to 1] for torque or [0 to 1] for position/force 
     virtual double scaleRefToCtrlValue(double ref);
     /// Scales the current control value into the units corresponding to the mode.
-    virtual double scaleCtrlValue(double ctrlValue, ControlMode mode);
+    double scaleCtrlValue(double ctrlValue, ControlMode mode);
     /// Called when CM is enabled (thread safe)
     virtual bool on_enable() override;
     /// Called when CM is disabled (thread safe)
@@ -290,12 +372,118 @@ public:
     /// Fills a Query with current state information
     void fillQuery(Query &q);
 
+protected:
+    /// Force and dFdt filter paths, one chain per FilterMode (in enum order).
+    /// All chains are allocated up front and only the selected one runs each tick.
+    using FilterPath = FilterSelector<FilterChain<PassStage>,
+                                      FilterChain<LowpassStage>,
+                                      FilterChain<MedianStage>,
+                                      FilterChain<MedianStage, LowpassStage>,
+                                      FilterChain<AverageStage>>;
+    /// Controller slot, one alternative per ControlMode. The active alternative is
+    /// resolved when a mode change is applied, so controlUpdate dispatches through
+    /// a variant index instead of virtual calls.
+    struct TorqueLoop      { };
+    struct PositionLoop    { };
+    struct ForceLoop       { };
+    struct ForceHybridLoop { };
+    struct CustomLoop      { CMController* controller; };  ///< type-erased fallback for ControlMode::Custom
+    using Controller = std::variant<TorqueLoop, PositionLoop, ForceLoop, ForceHybridLoop, CustomLoop>;
+    /// A parameter set with everything expensive to derive from it (filter
+    /// coefficients, median buffers) built on the caller's thread
+    struct PreparedParams {
+        PreparedParams(const Params& p);
+        Params               params;
+        Biquad::Coefficients ctrlCoeffs;
+        Biquad::Coefficients dFdtCoeffs;
+        Biquad::Coefficients outputCoeffs;
+        Biquad::Coefficients velocityCoeffs;
+        std::array<MedianStage, 4>  medians;   ///< one per MedianStage in the force then dFdt paths
+        std::array<AverageStage, 2> averages;  ///< one per AverageStage in the force then dFdt paths
+    };
+    /// A setter request, posted by any thread and applied by the control thread at
+    /// the start of the next update so that changes are tick-aligned
+    struct Command {
+        enum Type : int {
+            SetControlValue,
+            SetControlMode,
+            SetPositionRange,
+            SetPositionGains,
+            SetForceRange,
+            SetForceGains,
+            SetForceFeedForward,
+            SetVelocityMax,
+            SetTorqueMax,
+            SetForceFilterMode,
+            SetdFdtFilterMode,
+            SetParams,
+            EnableControlValueFilter,
+            SetPosCmdSign,
+            SetForceCmdSign,
+            SetPosSenseSign,
+            SetForceSenseSign,
+            ZeroForce,
+            QueueSegment,
+            ClearTrajectory,
+            StreamControlValue,
+            SetStreamInterpolation,
+            SetUserForceLimits,
+            SetUserPositionLimits
+        };
+        Type   type = SetControlValue;
+        double a    = 0;
+        double b    = 0;
+        double c    = 0;
+        bool   flag = false;
+        PreparedParams* prepared = nullptr;  ///< owned by the command (SetParams only)
+    };
+    /// Prepares params and queues them to be swapped in at the next tick (caller must hold m_cmdMutex)
+    void postParams(const Params& params);
+    /// Swaps prepared params into the controller, keeping filter state where possible
+    void applyParams(PreparedParams& prepared);
+    /// Update phases shared by update and CMBank: commands and sensors, then telemetry (DO NOT LOCK).
+    /// Without telemetry, Query publishing and FBuff are skipped (CMHub rate groups).
+    /// Without sense, beginUpdate leaves sensing to the caller (CMBank).
+    void beginUpdate(const mahi::util::Time& t, bool sense = true);
+    void endUpdate(const mahi::util::Time& t, bool telemetry = true);
+    /// Steps of acquire, split around the input filters so CMBank can run them for every DOF at once.
+    /// senseEncoder returns the velocity filter input, differentiateForce the dFdt filter input
+    /// (taken from m_sample.forceFiltered).
+    double senseEncoder(const mahi::util::Time& t);
+    void   senseVelocity(double filtered);
+    double senseForce();
+    double differentiateForce(const mahi::util::Time& t);
+    /// Rebuilds m_controller and m_cmdSign from m_ctrlMode and m_params (control thread or TASBI_LOCK)
+    void resolveController();
+    /// Controller loops dispatched by controlUpdate
+    void runLoop(const TorqueLoop&, double ctrlValue);
+    void runLoop(const PositionLoop&, double ctrlValue);
+    void runLoop(const ForceLoop&, double ctrlValue);
+    void runLoop(const ForceHybridLoop&, double ctrlValue);
+    void runLoop(const CustomLoop& loop, double ctrlValue);
+    /// Frees prepared params the control thread is done with (caller must hold m_cmdMutex)
+    void freeRetiredParams();
+    /// Queues a command for the control thread, returning false if it was dropped (caller must hold m_cmdMutex)
+    bool postCommand(Command::Type type, double a = 0, double b = 0, double c = 0, bool flag = false);
+    /// Applies all queued commands (control thread, or with m_mutex held)
+    void drainCommands();
+    /// Applies a single command
+    void applyCommand(const Command& cmd);
+    /// Drops the trajectory, counting its segments as finished (control thread)
+    void dropTrajectory();
+    /// Clamps a control value to the range of the requested control mode (caller must hold m_cmdMutex)
+    double clampControlValue(double value);
+    /// Records the supervisor trip cause and disables (control thread, without m_mutex held)
+    void trip(int cause);
+    /// True when called from the thread running this CM's update
+    bool onControlThread() const { return std::this_thread::get_id() == m_controlThread.load(std::memory_order_relaxed); }
+
 public:
 double m_torque=0;
 //Force Ringbuffer
 mahi::util::RingBuffer<double> FBuff{30};
 Params      m_params;    ///< parameters
-Butterworth  m_outputFilter;
+Biquad       m_outputFilter;
 
 protected:
     // Status and Congiguration
@@ -304,31 +492,50 @@ protected:
     Io          m_io;        ///< IO config
     //Params      m_params;    ///< parameters
     ControlMode m_ctrlMode;  ///< mode of control
+    Sample      m_sample;    ///< sensor values for the current tick
     Query       m_q;         ///< most recent Query point
-    RingBuffer<Query> m_Q;   ///< 10k Query history
+    Seqlock<Query> m_qPublished;  ///< m_q as published to other threads after each update
+    TelemetryRing<Query> m_Q;  ///< 10k Query history (lock-free, written by control thread only)
     // Control
     PdController m_positionPd;         ///< position PD controller
     PdController m_forcePd;            ///< force PD controller
     MiniPID      m_forcePID;
     Differentiator m_forceDiff;
-    Butterworth  m_ctrlFilter;         ///< butterworth filter that smooths control value setpoint (i.e. anti-aliases Unity 90 Hz commands)
-    FilterMode   m_forceFiltMode;
-    Butterworth  m_forceFilterL;        ///< filters raw voltage from integrated force sensor
-    MedianFilter m_forceFilterM;
-    FilterMode   m_dFdtFiltMode;
-    Butterworth  m_dFdtFilterL;        ///< filters raw voltage from derivative of integrated force sensor
-    MedianFilter m_dFdtFilterM;
-    AverageFilter<21> m_forceFilterA;
+    Biquad       m_ctrlFilter;         ///< butterworth filter that smooths control value setpoint (i.e. anti-aliases Unity 90 Hz commands)
+    FilterPath   m_forceFilter;        ///< filters raw voltage from integrated force sensor
+    FilterPath   m_dFdtFilter;         ///< filters raw voltage from derivative of integrated force sensor
     //Butterworth  m_outputFilter;
     Differentiator m_posDiff;
-    Butterworth    m_velocityFilter;
+    Biquad         m_velocityFilter;
     Differentiator m_forceRefDiff;
 
     double       m_ctrlValue;          ///< raw control value
     double       m_ctrlValueFiltered;  ///< filtered control value
     RateMonitor  m_feedRate;           ///< monitors ctrl value feed rate
+    Trajectory   m_trajectory;         ///< queued setpoint segments, evaluated every tick
+    std::atomic<std::uint64_t> m_segmentsDone;  ///< segments finished or dropped by the control thread
+    std::uint64_t m_segmentsQueued;    ///< segments accepted by queueSegment (m_cmdMutex)
+    SetpointStream m_stream;           ///< streamed setpoints, owns the setpoint while active
+    std::atomic<double> m_streamOffset;  ///< [s] tick time minus SetpointStream::clock(), updated every tick
+    // Safety
+    double       m_userForceMin;       ///< [N] subject limits checked by the CMHub supervisor
+    double       m_userForceMax;
+    double       m_userPositionMin;
+    double       m_userPositionMax;
+    std::atomic<int> m_tripCause;      ///< Trip bits that last disabled this CM
     std::shared_ptr<CMController> m_customController;
+    Controller   m_controller;         ///< active controller, resolved from m_ctrlMode
+    double       m_cmdSign;            ///< motor command sign for the active control mode
+    // Commands
+    SpscQueue<Command> m_commands;           ///< setter commands drained at the start of update
+    SpscQueue<PreparedParams*> m_retired;    ///< applied params handed back to be freed off the control thread
+    Params             m_paramsRequested;    ///< m_params as it will be once queued commands apply
+    ControlMode        m_ctrlModeRequested;  ///< m_ctrlMode as it will be once queued commands apply
+    std::atomic<int>   m_droppedCommands;    ///< commands dropped because the queue was full
+    std::uint64_t      m_configVersion;      ///< bumped whenever applied commands change the controller config
+    mutable std::mutex m_cmdMutex;           ///< serializes command producers (never taken by update)
     // Threading
     mutable std::mutex m_mutex;      ///< mutex for thready safety
-    mutable int        m_lockCount;  ///< the number of times the mutex has been locked
+    std::atomic<std::thread::id> m_controlThread;  ///< thread running the current update (the only one touching m_sample)
+    mutable int        m_lockCount;  ///< the number of times the mutex has been locked outside of update
 };
\ No newline at end of file
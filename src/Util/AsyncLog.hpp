@@ -0,0 +1,280 @@
+#pragma once
+
+#include <Mahi/Util/Logging/Log.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+
+/// Logging for code on the control thread. A call site declares a Format once
+/// (severity, text with {} placeholders, minimum repeat interval), and each log
+/// call copies the Format pointer plus up to MaxArgs numbers or short strings
+/// into a preallocated multi-producer ring. A background thread formats the
+/// entries and writes them to the mahi log sinks, so the hot path never
+/// allocates, locks, or touches the console. A full ring drops the message and
+/// counts it; repeats inside a Format's interval are suppressed and counted,
+/// and the count is reported with the next message that gets through. Messages
+/// logged with a source (e.g. the device) are rate limited per source, so one
+/// device's repeats never hide another's.
+class AsyncLog {
+public:
+    static constexpr std::size_t MaxArgs = 4;
+    static constexpr std::size_t MaxText = 32;  ///< string arguments are truncated to MaxText-1 characters
+
+    /// A message format, declared once per call site (normally static)
+    class Format {
+    public:
+        /// Sources rate limited separately per Format; later sources share the last slot
+        static constexpr std::size_t MaxSources = 16;
+
+        /// Constructor (interval is the minimum time between messages that are written [s])
+        Format(mahi::util::Severity severity, const char* text, double interval = 1.0) :
+            m_severity(severity),
+            m_text(text),
+            m_interval((std::int64_t)(interval * 1e9))
+        { }
+
+        mahi::util::Severity severity() const { return m_severity; }
+        const char* text() const { return m_text; }
+
+    private:
+        friend class AsyncLog;
+
+        /// Rate limiting state of one source
+        struct Limiter {
+            std::atomic<std::uintptr_t> source{0};
+            std::atomic<std::int64_t>   next{0};        ///< [ns] earliest time the next message is written
+            std::atomic<std::uint32_t>  suppressed{0};  ///< repeats since the last written message
+        };
+
+        /// Returns the limiter of source, claiming a free slot the first time a source is seen
+        Limiter& limiter(const void* source) {
+            // nullptr (no source) gets a key no object can have
+            const std::uintptr_t key = source ? (std::uintptr_t)source : 1;
+            for (auto& l : m_limiters) {
+                std::uintptr_t current = l.source.load(std::memory_order_acquire);
+                if (current == 0 && l.source.compare_exchange_strong(current, key, std::memory_order_acq_rel))
+                    return l;
+                if (current == key)
+                    return l;
+            }
+            return m_limiters[MaxSources - 1];
+        }
+
+        /// Returns true if a message from limiter l may be written at now [ns]; otherwise counts it as suppressed
+        bool admit(Limiter& l, std::int64_t now) {
+            std::int64_t next = l.next.load(std::memory_order_relaxed);
+            if (now >= next && l.next.compare_exchange_strong(next, now + m_interval, std::memory_order_relaxed))
+                return true;
+            l.suppressed.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        const mahi::util::Severity m_severity;
+        const char* const          m_text;
+        const std::int64_t         m_interval;    ///< [ns]
+        Limiter                    m_limiters[MaxSources];
+    };
+
+    /// Counters since construction
+    struct Stats {
+        std::uint64_t written    = 0;  ///< messages formatted and sent to the sinks
+        std::uint64_t dropped    = 0;  ///< messages lost because the ring was full
+        std::uint64_t suppressed = 0;  ///< repeats skipped by rate limiting
+    };
+
+    /// Constructor (capacity is rounded up to a power of two, period is the flush interval [s])
+    AsyncLog(std::size_t capacity = 1024, double period = 0.01) :
+        m_mask(roundUp(capacity) - 1),
+        m_slots(new Slot[m_mask + 1]),
+        m_tail(0),
+        m_head(0),
+        m_period(period),
+        m_dropped(0),
+        m_suppressed(0),
+        m_written(0),
+        m_running(true)
+    {
+        for (std::size_t i = 0; i <= m_mask; ++i)
+            m_slots[i].seq.store(i, std::memory_order_relaxed);
+        m_thread = std::thread([this]() { run(); });
+    }
+
+    /// Destructor, writes whatever is still queued
+    ~AsyncLog() {
+        m_running = false;
+        m_thread.join();
+    }
+
+    /// Shared logger used by CM and CMHub
+    static AsyncLog& get() {
+        static AsyncLog log;
+        return log;
+    }
+
+    /// Queues a message (numbers, const char* or std::string arguments). Safe on
+    /// any thread; never blocks or allocates. Returns false if the message was
+    /// rate limited or dropped.
+    template <typename... Args>
+    bool log(Format& format, const Args&... args) {
+        return log(nullptr, format, args...);
+    }
+
+    /// Queues a message rate limited separately for source (e.g. the device it is about)
+    template <typename... Args>
+    bool log(const void* source, Format& format, const Args&... args) {
+        static_assert(sizeof...(Args) <= MaxArgs, "AsyncLog supports at most MaxArgs arguments");
+        Format::Limiter& limiter = format.limiter(source);
+        if (!format.admit(limiter, now())) {
+            m_suppressed.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        // claim a slot (bounded MPMC ring with per-slot sequence numbers)
+        std::size_t pos = m_tail.load(std::memory_order_relaxed);
+        Slot* slot;
+        for (;;) {
+            slot = &m_slots[pos & m_mask];
+            std::size_t seq = slot->seq.load(std::memory_order_acquire);
+            std::ptrdiff_t diff = (std::ptrdiff_t)seq - (std::ptrdiff_t)pos;
+            if (diff == 0) {
+                if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0) {
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            else {
+                pos = m_tail.load(std::memory_order_relaxed);
+            }
+        }
+        Entry& e = slot->entry;
+        e.format     = &format;
+        e.suppressed = limiter.suppressed.exchange(0, std::memory_order_relaxed);
+        e.count      = 0;
+        int unpack[] = {0, (set(e.args[e.count++], args), 0)...};
+        (void)unpack;
+        slot->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// Counters since construction
+    Stats stats() const {
+        Stats s;
+        s.written    = m_written.load(std::memory_order_relaxed);
+        s.dropped    = m_dropped.load(std::memory_order_relaxed);
+        s.suppressed = m_suppressed.load(std::memory_order_relaxed);
+        return s;
+    }
+
+private:
+    /// A number or short string argument
+    struct Arg {
+        bool   isText;
+        double number;
+        char   text[MaxText];
+    };
+
+    struct Entry {
+        Format*       format;
+        std::uint32_t suppressed;  ///< repeats skipped before this message
+        std::size_t   count;
+        Arg           args[MaxArgs > 0 ? MaxArgs : 1];
+    };
+
+    struct Slot {
+        std::atomic<std::size_t> seq;
+        Entry                    entry;
+    };
+
+    static void set(Arg& a, const char* s) {
+        a.isText = true;
+        std::strncpy(a.text, s ? s : "", MaxText - 1);
+        a.text[MaxText - 1] = '\0';
+    }
+    static void set(Arg& a, const std::string& s) { set(a, s.c_str()); }
+    template <typename T>
+    static void set(Arg& a, const T& value) {
+        a.isText = false;
+        a.number = (double)value;
+    }
+
+    static std::int64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static std::size_t roundUp(std::size_t n) {
+        std::size_t p = 1;
+        while (p < n)
+            p <<= 1;
+        return p;
+    }
+
+    /// Replaces each {} in text with the next argument, formatted as operator<< would
+    static std::string expand(const Entry& e) {
+        std::ostringstream ss;
+        const char* t = e.format->text();
+        std::size_t next = 0;
+        while (*t) {
+            if (t[0] == '{' && t[1] == '}' && next < e.count) {
+                const Arg& a = e.args[next++];
+                if (a.isText)
+                    ss << a.text;
+                else
+                    ss << a.number;
+                t += 2;
+            }
+            else {
+                ss << *t++;
+            }
+        }
+        if (e.suppressed > 0)
+            ss << " (" << e.suppressed << " similar messages suppressed)";
+        return ss.str();
+    }
+
+    /// Writes every published entry to the log sinks (background thread)
+    void drain() {
+        for (;;) {
+            Slot& slot = m_slots[m_head & m_mask];
+            if (slot.seq.load(std::memory_order_acquire) != m_head + 1)
+                break;
+            LOG(slot.entry.format->severity()) << expand(slot.entry);
+            slot.seq.store(m_head + m_mask + 1, std::memory_order_release);
+            m_head++;
+            m_written.fetch_add(1, std::memory_order_relaxed);
+        }
+        std::uint64_t dropped = m_dropped.load(std::memory_order_relaxed);
+        if (dropped != m_droppedReported) {
+            LOG(mahi::util::Warning) << "Log ring full, dropped " << dropped - m_droppedReported << " messages.";
+            m_droppedReported = dropped;
+        }
+    }
+
+    void run() {
+        auto period = std::chrono::duration<double>(m_period);
+        while (m_running) {
+            drain();
+            std::this_thread::sleep_for(period);
+        }
+        drain();
+    }
+
+private:
+    const std::size_t          m_mask;
+    std::unique_ptr<Slot[]>    m_slots;
+    std::atomic<std::size_t>   m_tail;             ///< next slot to claim (producers)
+    std::size_t                m_head;             ///< next slot to write out (background thread)
+    const double               m_period;           ///< [s] flush interval
+    std::atomic<std::uint64_t> m_dropped;
+    std::atomic<std::uint64_t> m_suppressed;
+    std::atomic<std::uint64_t> m_written;
+    std::uint64_t              m_droppedReported = 0;
+    std::atomic<bool>          m_running;
+    std::thread                m_thread;
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cmath>
+
+/// Second-order IIR section (transposed direct form II). Coefficients are a
+/// plain value type, so they can be designed on one thread and handed to
+/// the control thread without allocating or disturbing the filter state.
+/// butterworth() is the same bilinear design as mahi::util::Butterworth(2, Wn),
+/// in closed form, so from the same (zero) state the outputs agree to rounding
+/// (checked by checkCM). Unlike Butterworth::configure, changing coefficients
+/// keeps the state, and prime() takes the place of Butterworth's seeding.
+class Biquad {
+public:
+    /// Normalized coefficients (a0 = 1)
+    struct Coefficients {
+        double b0 = 1, b1 = 0, b2 = 0;
+        double a1 = 0, a2 = 0;
+    };
+
+    /// Filter state, for handing a running filter between implementations
+    struct State {
+        double z1 = 0, z2 = 0;
+        double y  = 0;
+    };
+
+    /// Designs a 2nd order Butterworth lowpass with normalized cutoff Wn (1 = Nyquist)
+    static Coefficients butterworth(double Wn) {
+        const double pi   = 3.14159265358979323846;
+        const double k    = std::tan(pi * Wn / 2.0);
+        const double kk   = k * k;
+        const double norm = 1.0 / (1.0 + std::sqrt(2.0) * k + kk);
+        Coefficients c;
+        c.b0 = kk * norm;
+        c.b1 = 2.0 * c.b0;
+        c.b2 = c.b0;
+        c.a1 = 2.0 * (kk - 1.0) * norm;
+        c.a2 = (1.0 - std::sqrt(2.0) * k + kk) * norm;
+        return c;
+    }
+
+    Biquad() : m_z1(0), m_z2(0), m_y(0) { }
+    Biquad(const Coefficients& c) : m_c(c), m_z1(0), m_z2(0), m_y(0) { }
+
+    /// Filters a new sample and returns the output
+    double update(double x) {
+        m_y  = m_c.b0 * x + m_z1;
+        m_z1 = m_c.b1 * x - m_c.a1 * m_y + m_z2;
+        m_z2 = m_c.b2 * x - m_c.a2 * m_y;
+        return m_y;
+    }
+
+    /// Returns the most recent output
+    double get_value() const { return m_y; }
+
+    /// Replaces the coefficients while keeping the filter state
+    void set_coefficients(const Coefficients& c) { m_c = c; }
+
+    /// Returns the current coefficients
+    const Coefficients& get_coefficients() const { return m_c; }
+
+    /// Sets the state to the steady-state response to a constant input x
+    void prime(double x) {
+        double gain = (m_c.b0 + m_c.b1 + m_c.b2) / (1.0 + m_c.a1 + m_c.a2);
+        m_y  = gain * x;
+        m_z1 = m_y - m_c.b0 * x;
+        m_z2 = m_c.b2 * x - m_c.a2 * m_y;
+    }
+
+    /// Returns the current filter state
+    State get_state() const { return State{m_z1, m_z2, m_y}; }
+
+    /// Replaces the filter state
+    void set_state(const State& s) {
+        m_z1 = s.z1;
+        m_z2 = s.z2;
+        m_y  = s.y;
+    }
+
+    /// Clears the filter state
+    void reset() { m_z1 = m_z2 = m_y = 0; }
+
+private:
+    Coefficients m_c;
+    double       m_z1, m_z2;
+    double       m_y;
+};
@@ -0,0 +1,36 @@
+#include "Util/BiquadBank.hpp"
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+void BiquadBank::vector(Block& b) {
+#if defined(__AVX2__)
+    __m256d x  = _mm256_load_pd(b.x);
+    __m256d y  = _mm256_add_pd(_mm256_mul_pd(_mm256_load_pd(b.b0), x), _mm256_load_pd(b.z1));
+    __m256d z1 = _mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(_mm256_load_pd(b.b1), x),
+                                             _mm256_mul_pd(_mm256_load_pd(b.a1), y)),
+                               _mm256_load_pd(b.z2));
+    __m256d z2 = _mm256_sub_pd(_mm256_mul_pd(_mm256_load_pd(b.b2), x),
+                               _mm256_mul_pd(_mm256_load_pd(b.a2), y));
+    _mm256_store_pd(b.z1, z1);
+    _mm256_store_pd(b.z2, z2);
+    _mm256_store_pd(b.y, y);
+#elif defined(__SSE2__) || defined(_M_X64)
+    for (int k = 0; k < 4; k += 2) {
+        __m128d x  = _mm_load_pd(b.x + k);
+        __m128d y  = _mm_add_pd(_mm_mul_pd(_mm_load_pd(b.b0 + k), x), _mm_load_pd(b.z1 + k));
+        __m128d z1 = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(_mm_load_pd(b.b1 + k), x),
+                                           _mm_mul_pd(_mm_load_pd(b.a1 + k), y)),
+                                _mm_load_pd(b.z2 + k));
+        __m128d z2 = _mm_sub_pd(_mm_mul_pd(_mm_load_pd(b.b2 + k), x),
+                                _mm_mul_pd(_mm_load_pd(b.a2 + k), y));
+        _mm_store_pd(b.z1 + k, z1);
+        _mm_store_pd(b.z2 + k, z2);
+        _mm_store_pd(b.y + k, y);
+    }
+#else
+    reference(b);
+#endif
+}
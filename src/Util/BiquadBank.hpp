@@ -0,0 +1,154 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "Util/Biquad.hpp"
+
+/// A set of independent second-order sections advanced together. Coefficients,
+/// state, input and output of every 4 sections share one 32-byte aligned block,
+/// so a tick is one pass of aligned loads over contiguous memory, 4 sections per
+/// instruction with AVX2 (2 with SSE2) as cm is built (see CM_AVX2 in CMakeLists).
+/// The vector path uses the same operations in the same order as Biquad::update
+/// (no FMA), so each section matches a Biquad with the same coefficients bit for
+/// bit; Validate mode checks this on live data. Sections are padded to a multiple
+/// of 4 and never allocate after resize.
+class BiquadBank {
+public:
+    /// How update advances the sections
+    enum Mode : int {
+        Vector    = 0,  ///< SIMD when compiled for it, otherwise scalar
+        Reference = 1,  ///< scalar Biquad::update per section
+        Validate  = 2   ///< Reference results, counting sections where Vector differs
+    };
+
+    /// Constructor
+    BiquadBank(std::size_t sections = 0) : m_size(0), m_mode(Vector), m_mismatches(0) { resize(sections); }
+
+    /// Sets the number of sections, clearing coefficients to pass-through and state to 0 (allocates)
+    void resize(std::size_t sections) {
+        m_size = sections;
+        m_blocks.assign((sections + 3) / 4, Block());
+        for (auto& b : m_blocks) {
+            for (int k = 0; k < 4; ++k)
+                b.b0[k] = 1.0;
+        }
+    }
+
+    /// Number of sections
+    std::size_t size() const { return m_size; }
+
+    /// Sections rounded up to a multiple of 4 (valid update ranges end here at most)
+    std::size_t padded() const { return m_blocks.size() * 4; }
+
+    void set_mode(Mode mode) { m_mode = mode; }
+    Mode get_mode() const { return m_mode; }
+
+    /// Sections that differed from Reference in Validate mode since the last reset (thread safe)
+    std::uint64_t mismatches() const { return m_mismatches.load(std::memory_order_relaxed); }
+    void reset_mismatches() { m_mismatches.store(0, std::memory_order_relaxed); }
+
+    /// Input of section i for the next update
+    double& input(std::size_t i) { return m_blocks[i / 4].x[i % 4]; }
+
+    /// Output of section i from the last update
+    double output(std::size_t i) const { return m_blocks[i / 4].y[i % 4]; }
+
+    /// Replaces the coefficients of section i while keeping its state
+    void set_coefficients(std::size_t i, const Biquad::Coefficients& c) {
+        Block& b = m_blocks[i / 4];
+        std::size_t k = i % 4;
+        b.b0[k] = c.b0; b.b1[k] = c.b1; b.b2[k] = c.b2; b.a1[k] = c.a1; b.a2[k] = c.a2;
+    }
+
+    /// Returns the coefficients of section i
+    Biquad::Coefficients get_coefficients(std::size_t i) const {
+        const Block& b = m_blocks[i / 4];
+        std::size_t k = i % 4;
+        Biquad::Coefficients c;
+        c.b0 = b.b0[k]; c.b1 = b.b1[k]; c.b2 = b.b2[k]; c.a1 = b.a1[k]; c.a2 = b.a2[k];
+        return c;
+    }
+
+    /// Replaces the state of section i (e.g. taken from a Biquad)
+    void set_state(std::size_t i, const Biquad::State& s) {
+        Block& b = m_blocks[i / 4];
+        std::size_t k = i % 4;
+        b.z1[k] = s.z1; b.z2[k] = s.z2; b.y[k] = s.y;
+    }
+
+    /// Returns the state of section i (e.g. to hand back to a Biquad)
+    Biquad::State get_state(std::size_t i) const {
+        const Block& b = m_blocks[i / 4];
+        std::size_t k = i % 4;
+        return Biquad::State{b.z1[k], b.z2[k], b.y[k]};
+    }
+
+    /// Advances every section one sample
+    void update() { update(0, padded()); }
+
+    /// Advances sections [begin, end) one sample, begin and end multiples of 4 (or end == size()).
+    /// Disjoint ranges may be updated from different threads at once
+    void update(std::size_t begin, std::size_t end) {
+        const std::size_t first = begin / 4, last = (end + 3) / 4;
+        if (m_mode == Vector) {
+            for (std::size_t j = first; j < last; ++j)
+                vector(m_blocks[j]);
+            return;
+        }
+        std::uint64_t mismatches = 0;
+        for (std::size_t j = first; j < last; ++j) {
+            Block& b = m_blocks[j];
+            if (m_mode == Validate) {
+                Block v = b;
+                vector(v);
+                reference(b);
+                for (int k = 0; k < 4; ++k)
+                    mismatches += !same(v.y[k], b.y[k]) || !same(v.z1[k], b.z1[k]) || !same(v.z2[k], b.z2[k]);
+            }
+            else {
+                reference(b);
+            }
+        }
+        if (mismatches > 0)
+            m_mismatches.fetch_add(mismatches, std::memory_order_relaxed);
+    }
+
+private:
+    /// Four sections, one 32-byte line per field
+    struct alignas(32) Block {
+        double x[4]  = {0, 0, 0, 0};
+        double y[4]  = {0, 0, 0, 0};
+        double b0[4] = {0, 0, 0, 0}, b1[4] = {0, 0, 0, 0}, b2[4] = {0, 0, 0, 0};
+        double a1[4] = {0, 0, 0, 0}, a2[4] = {0, 0, 0, 0};
+        double z1[4] = {0, 0, 0, 0}, z2[4] = {0, 0, 0, 0};
+    };
+
+    /// Bitwise equality (a NaN matches an identical NaN)
+    static bool same(double a, double b) { return std::memcmp(&a, &b, sizeof(double)) == 0; }
+
+    /// Runs each section of a block through a Biquad
+    static void reference(Block& b) {
+        for (int k = 0; k < 4; ++k) {
+            Biquad::Coefficients c;
+            c.b0 = b.b0[k]; c.b1 = b.b1[k]; c.b2 = b.b2[k]; c.a1 = b.a1[k]; c.a2 = b.a2[k];
+            Biquad section(c);
+            section.set_state(Biquad::State{b.z1[k], b.z2[k], b.y[k]});
+            section.update(b.x[k]);
+            Biquad::State s = section.get_state();
+            b.z1[k] = s.z1; b.z2[k] = s.z2; b.y[k] = s.y;
+        }
+    }
+
+    /// Same arithmetic as Biquad::update, vectorized (in BiquadBank.cpp, so every user
+    /// of the header links the kernel cm was compiled with)
+    static void vector(Block& b);
+
+private:
+    std::vector<Block>         m_blocks;  ///< sections 4i..4i+3 in block i
+    std::size_t                m_size;
+    Mode                       m_mode;
+    std::atomic<std::uint64_t> m_mismatches;
+};
@@ -0,0 +1,70 @@
+#include "Util/CapstanPlant.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    constexpr double DEG2RAD = 3.141592653589793 / 180.0;
+}
+
+CapstanPlant::CapstanPlant(const Params& params) :
+    m_params(params),
+    m_lever(params.gearRatio / DEG2RAD * 1e-3)
+{
+    // Mindlin tangential compliance of the preloaded contact [m/N], as N/mm
+    ContactMechanics::HertzianContact hz;
+    double a  = hz.getContactRadius_Normal(m_params.indenterRadius, m_params.normalPreload);
+    double Ct = hz.getCompliance_Tan(m_params.skinModulus, m_params.skinPoisson, a)[1];
+    m_tangentialStiffness = Ct > 0 ? 1e-3 / Ct : 0.0;
+}
+
+double CapstanPlant::fitModulus(double R, double Fn, double deltaN) {
+    ContactMechanics::HertzianContact hz;
+    return hz.getCombinedE_Normal(R, Fn, deltaN);
+}
+
+double CapstanPlant::contactForce(double spool) const {
+    double delta = spool - m_params.contactPosition;
+    if (m_params.tangential)
+        return m_tangentialStiffness * delta;
+    if (delta <= 0)
+        return 0.0;
+    // Hertz with R and delta in m
+    return 4.0 / 3.0 * m_params.skinModulus * std::sqrt(m_params.indenterRadius * 1e-3) * std::pow(delta * 1e-3, 1.5);
+}
+
+void CapstanPlant::step(double volts, bool enabled, double dt) {
+    if (dt <= 0)
+        return;
+    const int    n = std::max(1, (int)std::ceil(dt / m_params.maxStep));
+    const double h = dt / n;
+    const double J = m_params.inertia;
+    m_state.torque = enabled ? volts * m_params.commandGain * m_params.torqueConstant : 0.0;
+    double theta = m_state.position * DEG2RAD;
+    double omega = m_state.velocity * DEG2RAD;
+    for (int i = 0; i < n; ++i) {
+        double force = contactForce(theta / DEG2RAD * m_params.gearRatio);
+        double tau   = m_state.torque - force * m_lever - m_params.damping * omega;
+        omega += h * tau / J;
+        // dry friction can stop the motor but never reverse it
+        double stick = h * m_params.coulomb / J;
+        omega = std::abs(omega) <= stick ? 0.0 : omega - std::copysign(stick, omega);
+        theta += h * omega;
+    }
+    m_state.position = theta / DEG2RAD;
+    m_state.velocity = omega / DEG2RAD;
+    m_state.force    = contactForce(m_state.position * m_params.gearRatio);
+}
+
+int CapstanPlant::counts() const {
+    return (int)std::lround(m_state.position / m_params.degPerCount);
+}
+
+double CapstanPlant::countsPerSecond() const {
+    return m_state.velocity / m_params.degPerCount;
+}
+
+void CapstanPlant::reset(double position) {
+    m_state          = State();
+    m_state.position = position;
+    m_state.force    = contactForce(position * m_params.gearRatio);
+}
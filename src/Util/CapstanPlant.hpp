@@ -0,0 +1,63 @@
+#pragma once
+
+#include "Util/HertzianContact.hpp"
+
+/// Lumped model of one capstan DOF pressing a spherical indenter into skin: a
+/// current-driven DC motor, a rigid cable capstan (spool) and a Hertzian contact
+/// (Johnson, 1985) whose stiffness comes from HertzianContact. Normal DOFs load
+/// the skin with F = 4/3 E* sqrt(R) d^(3/2); tangential DOFs load it through the
+/// Mindlin no-slip stiffness at a fixed normal preload. Units follow CM::Params
+/// (deg, mm, N) and are integrated with semi-implicit Euler substeps.
+class CapstanPlant {
+public:
+    /// Plant Parameters (defaults match CM::Params and a fingertip pad)
+    struct Params {
+        double torqueConstant  = 0.0146;                                // [Nm/A]
+        double commandGain     = 1.35 / 10.0;                           // [A/V] motor amplifier
+        double gearRatio       = 0.332 * 25.4 * 3.141592653589793 / 360.0; // [mm/deg] spool travel per motor degree
+        double degPerCount     = 360.0 / (1024.0 * 35.0);               // [deg/count]
+        double inertia         = 5e-6;                                  // [kg m^2] rotor and spool
+        double damping         = 2e-5;                                  // [Nm s/rad] viscous friction
+        double coulomb         = 2e-4;                                  // [Nm] dry friction
+        bool   tangential      = false;                                 // load skin in shear instead of normal
+        double contactPosition = 0.0;                                   // [mm] spool position where the indenter touches skin
+        double indenterRadius  = 10.0;                                  // [mm] R
+        double skinModulus     = 1e5;                                   // [N/m^2] combined Young's modulus E*
+        double skinPoisson     = 0.45;                                  // [-] nu
+        double normalPreload   = 2.0;                                   // [mm] indentation depth held during tangential loading
+        double maxStep         = 100e-6;                                // [s] largest integration substep
+    };
+
+    /// Integrated State
+    struct State {
+        double position = 0;  ///< motor position [deg]
+        double velocity = 0;  ///< motor velocity [deg/s]
+        double force    = 0;  ///< contact force on the indenter [N]
+        double torque   = 0;  ///< motor torque [Nm]
+    };
+
+    /// Constructor
+    CapstanPlant(const Params& params);
+    /// Combined modulus E* [N/m^2] matching one measured (indentation [mm], force [N]) point
+    static double fitModulus(double R, double Fn, double deltaN);
+    /// Advances the plant by dt [s] with the amplifier commanded at volts (no torque if disabled)
+    void step(double volts, bool enabled, double dt);
+    /// Contact force [N] at a spool position [mm]
+    double contactForce(double spool) const;
+    /// Current state
+    const State& state() const { return m_state; }
+    /// Encoder counts for the current position
+    int counts() const;
+    /// Encoder counts per second for the current velocity
+    double countsPerSecond() const;
+    /// Moves the motor to a position [deg] at rest
+    void reset(double position = 0.0);
+    /// Plant parameters
+    const Params& params() const { return m_params; }
+
+private:
+    Params m_params;
+    State  m_state;
+    double m_lever;                ///< [m/rad] spool travel per motor radian
+    double m_tangentialStiffness;  ///< [N/mm] Mindlin no-slip stiffness at the normal preload
+};
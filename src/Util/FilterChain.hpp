@@ -0,0 +1,147 @@
+#pragma once
+
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "Util/Biquad.hpp"
+#include "Util/MedianFilter.hpp"
+
+//==============================================================================
+// STAGES (each provides filter(x), get_value() and prime(x))
+//==============================================================================
+
+/// Passes samples through unchanged
+class PassStage {
+public:
+    double filter(double x) { m_value = x; return x; }
+    double get_value() const { return m_value; }
+    void   prime(double x) { m_value = x; }
+private:
+    double m_value = 0;
+};
+
+/// 2nd order lowpass section
+class LowpassStage : public Biquad {
+public:
+    double filter(double x) { return update(x); }
+};
+
+/// Sliding window median
+class MedianStage : public MedianFilter {
+public:
+    MedianStage(int N = 1) : MedianFilter(N) { }
+};
+
+/// Moving average
+class AverageStage : public DynamicAverageFilter {
+public:
+    AverageStage(int N = 1) : DynamicAverageFilter(N) { }
+};
+
+//==============================================================================
+// FILTER CHAIN
+//==============================================================================
+
+/// A fixed sequence of filter stages, composed at compile time so the whole
+/// chain inlines into a straight run of stage updates, e.g.
+/// FilterChain<MedianStage, LowpassStage> feeds the median into the lowpass.
+template <typename... Stages>
+class FilterChain {
+    static_assert(sizeof...(Stages) > 0, "FilterChain needs at least one stage");
+
+public:
+    /// Runs x through every stage and returns the output of the last
+    double filter(double x) {
+        std::apply([&x](auto&... stage) { ((x = stage.filter(x)), ...); }, m_stages);
+        return x;
+    }
+
+    /// Returns the most recent output of the last stage
+    double get_value() const { return std::get<sizeof...(Stages) - 1>(m_stages).get_value(); }
+
+    /// Puts every stage in its steady state for a constant input x
+    void prime(double x) {
+        std::apply([x](auto&... stage) { (stage.prime(x), ...); }, m_stages);
+    }
+
+    /// Calls f on every stage of type Stage
+    template <typename Stage, typename F>
+    void for_each(F&& f) {
+        std::apply([&f](auto&... stage) { (visit<Stage>(stage, f), ...); }, m_stages);
+    }
+
+    /// Returns stage I
+    template <std::size_t I>
+    auto& stage() { return std::get<I>(m_stages); }
+
+private:
+    template <typename Stage, typename S, typename F>
+    static void visit(S& stage, F& f) {
+        if constexpr (std::is_same<Stage, S>::value)
+            f(stage);
+    }
+
+    std::tuple<Stages...> m_stages;
+};
+
+//==============================================================================
+// FILTER SELECTOR
+//==============================================================================
+
+/// Holds one FilterChain per mode, all allocated up front, and runs only the
+/// selected one. Switching chains primes the new one with the last output so
+/// the filtered signal does not jump.
+template <typename... Chains>
+class FilterSelector {
+public:
+    /// Filters x through the selected chain (x passes through if none is selected)
+    double filter(double x) {
+        m_value = filterImpl(x, std::index_sequence_for<Chains...>{});
+        return m_value;
+    }
+
+    /// Returns the most recent output
+    double get_value() const { return m_value; }
+
+    /// Records an output computed outside the selector (a banked copy of the selected chain)
+    void set_value(double y) { m_value = y; }
+
+    /// Selects chain i, priming it at the current output if it changed
+    void select(int i) {
+        if (i == m_selected)
+            return;
+        m_selected = i;
+        primeImpl(m_value, std::index_sequence_for<Chains...>{});
+    }
+
+    /// Returns the index of the selected chain
+    int selected() const { return m_selected; }
+
+    /// Calls f on every stage of type Stage in every chain
+    template <typename Stage, typename F>
+    void for_each(F&& f) {
+        std::apply([&f](auto&... chain) { (chain.template for_each<Stage>(f), ...); }, m_chains);
+    }
+
+    /// Returns chain I
+    template <std::size_t I>
+    auto& chain() { return std::get<I>(m_chains); }
+
+private:
+    template <std::size_t... Is>
+    double filterImpl(double x, std::index_sequence<Is...>) {
+        double y = x;
+        (void)((m_selected == (int)Is ? (y = std::get<Is>(m_chains).filter(x), true) : false) || ...);
+        return y;
+    }
+
+    template <std::size_t... Is>
+    void primeImpl(double x, std::index_sequence<Is...>) {
+        (void)((m_selected == (int)Is ? (std::get<Is>(m_chains).prime(x), true) : false) || ...);
+    }
+
+    std::tuple<Chains...> m_chains;
+    int                   m_selected = 0;
+    double                m_value    = 0;
+};
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <Mahi/Util/Timing/Frequency.hpp>
+#include <Mahi/Util/Timing/Time.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+/// Fixed-rate loop timer with the same interface as mahi::util::Timer. In Hybrid
+/// mode it sleeps until a margin before each deadline and busy-waits the rest,
+/// so the thread only spins for the last few tens of microseconds per tick. The
+/// margin tunes itself from the measured oversleep (wake-up latency) of the OS.
+class HybridTimer {
+public:
+    using Clock     = std::chrono::steady_clock;
+    using TimePoint = Clock::time_point;
+    using Duration  = Clock::duration;
+
+    /// Smallest sleep margin before each deadline
+    static constexpr Duration MinMargin = std::chrono::microseconds(50);
+
+    /// Waiting strategy
+    enum WaitMode {
+        Busy,   ///< spin for the whole wait (lowest jitter, one core at 100%)
+        Hybrid  ///< sleep until the margin, then spin
+    };
+
+    HybridTimer(mahi::util::Frequency frequency, WaitMode mode = Hybrid) :
+        HybridTimer(frequency.to_time(), mode)
+    { }
+
+    HybridTimer(mahi::util::Time period, WaitMode mode = Hybrid) :
+        m_period(std::chrono::microseconds(period.as_microseconds())),
+        m_mode(mode)
+    {
+        restart();
+    }
+
+    /// Restarts the timer and its statistics, returning the elapsed time before the restart
+    mahi::util::Time restart() {
+        mahi::util::Time elapsed = get_elapsed_time();
+        m_start     = Clock::now();
+        m_ticks     = 0;
+        m_misses    = 0;
+        m_waitRatio = 0;
+        m_waited    = Duration::zero();
+        m_slept     = Duration::zero();
+        m_peakLate  = Duration::zero();
+        m_margin    = std::min(MinMargin, m_period);
+        return elapsed;
+    }
+
+    /// Waits until the next tick, returning the elapsed time
+    mahi::util::Time wait() {
+        m_ticks++;
+        TimePoint deadline = m_start + m_period * m_ticks;
+        TimePoint now      = Clock::now();
+        if (now > deadline) {
+            m_misses++;
+            m_waitRatio = 0;
+            if (!m_skipMissed)
+                return get_elapsed_time();
+            // count every deadline that already passed and wait for the first one ahead
+            std::int64_t passed = (now - m_start) / m_period;
+            m_misses += passed - m_ticks;
+            m_ticks   = passed + 1;
+            deadline  = m_start + m_period * m_ticks;
+        }
+        m_waitRatio = std::chrono::duration<double>(deadline - now) / m_period;
+        tune(Duration::zero());
+        TimePoint waitStart = now;
+        if (m_mode == Hybrid && deadline - now > m_margin) {
+            TimePoint target = deadline - m_margin;
+            std::this_thread::sleep_until(target);
+            now = Clock::now();
+            m_slept += now - waitStart;
+            tune(now - target);
+        }
+        while (now < deadline)
+            now = Clock::now();
+        m_waited += now - waitStart;
+        return get_elapsed_time();
+    }
+
+    /// If true, a late wait skips every deadline that already passed instead of
+    /// returning at once for each of them (so overruns never cause a burst of ticks)
+    void set_skip_missed(bool skip) { m_skipMissed = skip; }
+
+    /// Actual time elapsed since the last restart
+    mahi::util::Time get_elapsed_time() const { return toTime(Clock::now() - m_start); }
+    /// Ideal time elapsed since the last restart (ticks * period)
+    mahi::util::Time get_elapsed_time_ideal() const { return toTime(m_period * m_ticks); }
+    /// Number of ticks since the last restart
+    std::int64_t get_elapsed_ticks() const { return m_ticks; }
+    /// Number of ticks whose deadline had already passed
+    std::int64_t get_misses() const { return m_misses; }
+    /// Fraction of ticks that were missed
+    double get_miss_rate() const { return m_ticks > 0 ? (double)m_misses / (double)m_ticks : 0.0; }
+    /// Fraction of the last period spent waiting
+    double get_wait_ratio() const { return m_waitRatio; }
+    /// Fraction of all waiting spent asleep instead of spinning (the CPU saved versus Busy)
+    double get_sleep_ratio() const {
+        return m_waited > Duration::zero() ? std::chrono::duration<double>(m_slept) / m_waited : 0.0;
+    }
+    /// Current sleep margin before each deadline
+    mahi::util::Time get_margin() const { return toTime(m_margin); }
+    /// Loop period
+    mahi::util::Time get_period() const { return toTime(m_period); }
+    /// Waiting strategy
+    WaitMode get_wait_mode() const { return m_mode; }
+
+    /// Margin rule applied every tick: folds the oversleep late into peak, a worst case that
+    /// decays by 1/1024 per tick, and returns twice the peak clamped to [MinMargin, period]
+    /// (so a margin pushed up to a full period eventually retries sleeping)
+    static Duration tune_margin(Duration late, Duration& peak, Duration period) {
+        peak = std::max(late, peak - peak / 1024);
+        return std::min(std::max(2 * peak, MinMargin), period);
+    }
+
+private:
+    static mahi::util::Time toTime(Duration d) {
+        return mahi::util::microseconds(std::chrono::duration_cast<std::chrono::microseconds>(d).count());
+    }
+
+    /// Keeps the margin at twice the recent worst oversleep
+    void tune(Duration late) {
+        m_margin = tune_margin(late, m_peakLate, m_period);
+    }
+
+    Duration     m_period;
+    WaitMode     m_mode;
+    TimePoint    m_start;
+    std::int64_t m_ticks     = 0;
+    std::int64_t m_misses    = 0;
+    double       m_waitRatio = 0;
+    Duration     m_waited    = Duration::zero();  ///< total time spent waiting
+    Duration     m_slept     = Duration::zero();  ///< part of m_waited spent asleep
+    Duration     m_peakLate  = Duration::zero();  ///< decaying peak of oversleep
+    Duration     m_margin    = MinMargin;         ///< how early to wake before each deadline
+    bool         m_skipMissed = false;
+};
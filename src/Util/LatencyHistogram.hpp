@@ -0,0 +1,120 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+/// Percentile summary of a LatencyHistogram plus a coarse power-of-two view for
+/// plotting (bin i counts samples in [2^(i-1), 2^i) us, bin 0 counts 0 us).
+/// Trivially copyable so it can be published in a Query.
+struct LatencyStats {
+    static constexpr int Bins = 24;
+    double p50  = 0;  ///< [us]
+    double p99  = 0;  ///< [us]
+    double p999 = 0;  ///< [us]
+    double max  = 0;  ///< [us]
+    int    bins[Bins] = {};
+};
+
+/// Fixed-size HDR-style histogram of microsecond latencies. Buckets are
+/// log-linear (32 linear sub-buckets per power of two, so values are kept to
+/// within ~3%) up to about 4 s. Recording never allocates and is O(1).
+class LatencyHistogram {
+public:
+    static constexpr int          SubBits  = 5;
+    static constexpr int          SubCount = 1 << SubBits;
+    static constexpr int          Exps     = 16;
+    static constexpr int          Buckets  = (Exps + 2) * SubCount;
+    static constexpr std::int64_t MaxValue = (std::int64_t(2 * SubCount) << Exps) - 1;
+
+    LatencyHistogram() { reset(); }
+
+    /// Records a latency in microseconds (clamped to [0, MaxValue])
+    void record(std::int64_t us) {
+        us = std::min(std::max(us, std::int64_t(0)), MaxValue);
+        m_counts[index(us)]++;
+        m_count++;
+        m_max = std::max(m_max, us);
+    }
+
+    /// Returns the smallest recorded value (to bucket precision) that p percent of samples do not exceed
+    std::int64_t percentile(double p) const {
+        if (m_count == 0)
+            return 0;
+        std::uint64_t rank = (std::uint64_t)(p / 100.0 * (double)m_count + 0.5);
+        rank = std::min(std::max(rank, std::uint64_t(1)), m_count);
+        std::uint64_t seen = 0;
+        for (int i = 0; i < Buckets; ++i) {
+            seen += m_counts[i];
+            if (seen >= rank)
+                return std::min(highest(i), m_max);
+        }
+        return m_max;
+    }
+
+    /// Largest recorded value
+    std::int64_t max() const { return m_max; }
+
+    /// Number of recorded values
+    std::uint64_t count() const { return m_count; }
+
+    /// Fills stats with percentiles and the coarse power-of-two view
+    void summarize(LatencyStats& stats) const {
+        stats.p50  = (double)percentile(50.0);
+        stats.p99  = (double)percentile(99.0);
+        stats.p999 = (double)percentile(99.9);
+        stats.max  = (double)m_max;
+        std::fill(std::begin(stats.bins), std::end(stats.bins), 0);
+        for (int i = 0; i < Buckets; ++i) {
+            if (m_counts[i] == 0)
+                continue;
+            int bin = 0;
+            for (std::int64_t v = lowest(i); v > 0 && bin < LatencyStats::Bins - 1; v >>= 1)
+                ++bin;
+            stats.bins[bin] += (int)std::min<std::uint64_t>(m_counts[i], 0x7fffffff);
+        }
+    }
+
+    /// Clears all samples
+    void reset() {
+        m_counts.fill(0);
+        m_count = 0;
+        m_max   = 0;
+    }
+
+private:
+    /// Bucket for value v: the first 2*SubCount values map directly, after that
+    /// each power of two is split into SubCount linear buckets
+    static int index(std::int64_t v) {
+        int exp = std::max(0, msb((std::uint64_t)v) - SubBits);
+        return exp * SubCount + (int)(v >> exp);
+    }
+
+    /// Smallest value that maps to bucket i
+    static std::int64_t lowest(int i) {
+        int exp = std::max(0, i / SubCount - 1);
+        return std::int64_t(i - exp * SubCount) << exp;
+    }
+
+    /// Largest value that maps to bucket i
+    static std::int64_t highest(int i) {
+        int exp = std::max(0, i / SubCount - 1);
+        return lowest(i) + (std::int64_t(1) << exp) - 1;
+    }
+
+    /// Index of the highest set bit (0 for x = 0)
+    static int msb(std::uint64_t x) {
+        int n = 0;
+        for (int shift = 32; shift > 0; shift >>= 1) {
+            if (x >> shift) {
+                x >>= shift;
+                n += shift;
+            }
+        }
+        return n;
+    }
+
+    std::array<std::uint64_t, Buckets> m_counts;
+    std::uint64_t                      m_count;
+    std::int64_t                       m_max;
+};
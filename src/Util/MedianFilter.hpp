@@ -2,46 +2,164 @@
 
 #pragma once
 
+#include <algorithm>
 #include <array>
+#include <vector>
 
+/// Sliding window median over the last N samples (window starts zero filled).
+/// Samples live in a circular buffer indexed by a combined max/min heap centered
+/// on the median (the "Mediator" scheme), so each new sample costs
+/// O(log N) and nothing is allocated or copied after resize().
 class MedianFilter {
 public:
     MedianFilter(int N)  { resize(N); }
     double filter(double sample) {
-        size_t W = buffer1.size();
-        buffer1[W-1] = sample;
-        buffer2 = buffer1;
-        std::sort(buffer2.begin(), buffer2.end());
-        size_t M = W/2;
-        value = buffer2[M];
-        for (size_t i = 1; i < W; ++i)
-            buffer1[i-1] = buffer1[i];
+        int    p   = pos[idx];
+        double old = data[idx];
+        data[idx]  = sample;
+        idx        = (idx + 1) % N;
+        if (p > 0) {         // replaced sample is in the min heap
+            if (old < sample) minSortDown(p*2);
+            else if (minSortUp(p)) maxSortDown(-1);
+        }
+        else if (p < 0) {    // replaced sample is in the max heap
+            if (sample < old) maxSortDown(p*2);
+            else if (maxSortUp(p)) minSortDown(1);
+        }
+        else {               // replaced sample is the median
+            if (maxCt()) maxSortDown(-1);
+            if (minCt()) minSortDown(1);
+        }
+        value = data[heap(0)];
         return value;
     }   
-    void resize(int N) { buffer1.resize(N); buffer2.resize(N); } 
-    double get_value(){return value;}
+    void resize(int N_) {
+        N = N_ > 0 ? N_ : 1;
+        data.assign(N, 0.0);
+        pos.assign(N, 0);
+        storage.assign(N, 0);
+        // initial fill pattern: median, max, min, max, min, ...
+        for (int i = 0; i < N; ++i) {
+            pos[i] = ((i+1)/2) * ((i&1) ? -1 : 1);
+            heap(pos[i]) = i;
+        }
+        idx   = 0;
+        value = 0;
+    } 
+    /// Fills the window with x, as if x had been filtered N times
+    void prime(double x) {
+        std::fill(data.begin(), data.end(), x);
+        value = x;
+    }
+    int size() const { return N; }
+    double get_value() const {return value;}
 private:
-    double value;
-    std::vector<double> buffer1;
-    std::vector<double> buffer2;
+    int& heap(int i) { return storage[N/2 + i]; }
+    int  heap(int i) const { return storage[N/2 + i]; }
+    int  minCt() const { return (N-1)/2; }  // items in the min heap (above the median)
+    int  maxCt() const { return N/2; }      // items in the max heap (below the median)
+    bool less(int i, int j) const { return data[heap(i)] < data[heap(j)]; }
+    bool exchange(int i, int j) {
+        int t   = heap(i);
+        heap(i) = heap(j);
+        heap(j) = t;
+        pos[heap(i)] = i;
+        pos[heap(j)] = j;
+        return true;
+    }
+    bool cmpExchange(int i, int j) { return less(i,j) && exchange(i,j); }
+    // sift down starting from child i (its sibling is only in the same heap below the root)
+    void minSortDown(int i) {
+        for (; i <= minCt(); i *= 2) {
+            if (i > 1 && i < minCt() && less(i+1, i)) ++i;
+            if (!cmpExchange(i, i/2)) break;
+        }
+    }
+    void maxSortDown(int i) {
+        for (; i >= -maxCt(); i *= 2) {
+            if (i < -1 && i > -maxCt() && less(i, i-1)) --i;
+            if (!cmpExchange(i/2, i)) break;
+        }
+    }
+    bool minSortUp(int i) {
+        while (i > 0 && cmpExchange(i, i/2)) i /= 2;
+        return i == 0;
+    }
+    bool maxSortUp(int i) {
+        while (i < 0 && cmpExchange(i/2, i)) i /= 2;
+        return i == 0;
+    }
+private:
+    int N = 0;
+    int idx = 0;
+    double value = 0;
+    std::vector<double> data;     ///< circular window of samples
+    std::vector<int>    pos;      ///< heap position of each sample
+    std::vector<int>    storage;  ///< heap storage, heap(i) for i in [-N/2, (N-1)/2]
 };
 
-template <int T>
-class AverageFilter  {
+/// Moving average over the last N samples (window starts zero filled). The sum
+/// is maintained incrementally from a circular buffer, and recomputed with Kahan
+/// summation once per pass through the window so rounding error cannot drift.
+template <typename Buffer>
+class MovingAverage {
 public:
-    AverageFilter() { 
-        for (int i = 0; i < T; ++i)
-            s[i] = 0;
-    }
     double filter(double in) {
-        s[T-1] = in;
-        double sum = s[0];
-        for (int i = 1; i < T; ++i) {
-            sum += s[i];
-            s[i-1] = s[i];
+        double& oldest = s[idx];
+        sum   += in - oldest;
+        oldest = in;
+        if (++idx == (int)s.size()) {
+            idx = 0;
+            resync();
         }
-        return sum / T;
+        value = sum / s.size();
+        return value;
     }
-private:
-    double s[T];
-};
\ No newline at end of file
+    double get_value() const { return value; }
+    int size() const { return (int)s.size(); }
+    /// Fills the window with x, as if x had been filtered N times
+    void prime(double x) {
+        std::fill(s.begin(), s.end(), x);
+        idx = 0;
+        resync();
+        value = x;
+    }
+protected:
+    void clear() {
+        std::fill(s.begin(), s.end(), 0.0);
+        idx   = 0;
+        sum   = 0;
+        value = 0;
+    }
+    void resync() {
+        double total = 0, c = 0;
+        for (double x : s) {
+            double y = x - c;
+            double t = total + y;
+            c        = (t - total) - y;
+            total    = t;
+        }
+        sum = total;
+    }
+    Buffer s;
+    int    idx   = 0;
+    double sum   = 0;
+    double value = 0;
+};
+
+/// Moving average with a compile-time window length
+template <int T>
+class AverageFilter : public MovingAverage<std::array<double, T>> {
+public:
+    AverageFilter() { this->clear(); }
+};
+
+/// Moving average with a window length chosen at runtime
+class DynamicAverageFilter : public MovingAverage<std::vector<double>> {
+public:
+    DynamicAverageFilter(int N) { resize(N); }
+    void resize(int N) {
+        s.resize(N > 0 ? N : 1);
+        clear();
+    }
+};
@@ -0,0 +1,101 @@
+#include "Util/RealTime.hpp"
+#include <Mahi/Util/Logging/Log.hpp>
+#include <cstdlib>
+#include <cerrno>
+#include <cstring>
+#if defined(__linux__)
+    #include <alloca.h>
+    #include <malloc.h>
+    #include <pthread.h>
+    #include <sched.h>
+    #include <sys/mman.h>
+#elif defined(_WIN32)
+    #define NOMINMAX
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+#endif
+
+using namespace mahi::util;
+
+namespace {
+
+/// Touches size bytes of stack below the caller so later ticks don't page fault
+void prefaultStack(std::size_t size) {
+#if defined(__linux__)
+    volatile unsigned char* stack = static_cast<unsigned char*>(alloca(size));
+    for (std::size_t i = 0; i < size; i += 4096)
+        stack[i] = 0;
+#else
+    (void)size;
+#endif
+}
+
+/// Touches size bytes of heap and hands it back to malloc without returning it to the OS
+bool prefaultHeap(std::size_t size) {
+#if defined(__linux__)
+    // keep freed memory in the process and serve large requests from the heap
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+#endif
+    unsigned char* heap = static_cast<unsigned char*>(std::malloc(size));
+    if (!heap)
+        return false;
+    std::memset(heap, 0, size);
+    std::free(heap);
+    return true;
+}
+
+} // namespace
+
+RtStatus applyRealTime(const RtConfig& config) {
+    RtStatus status;
+    if (!config.enabled)
+        return status;
+#if defined(__linux__)
+    if (config.priority > 0) {
+        sched_param param;
+        param.sched_priority = config.priority;
+        int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (err == 0)
+            status.priority = config.priority;
+        else
+            LOG(Warning) << "Could not set SCHED_FIFO priority " << config.priority << " (" << std::strerror(err) << "). Running with default scheduling.";
+    }
+    if (config.cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(config.cpu, &set);
+        int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (err == 0)
+            status.cpu = config.cpu;
+        else
+            LOG(Warning) << "Could not pin thread to CPU " << config.cpu << " (" << std::strerror(err) << ").";
+    }
+    if (config.lockMemory) {
+        if (mlockall(MCL_CURRENT | MCL_FUTURE) == 0)
+            status.memoryLocked = true;
+        else
+            LOG(Warning) << "Could not lock memory (" << std::strerror(errno) << "). Page faults may cause timer misses.";
+    }
+#elif defined(_WIN32)
+    if (config.priority > 0) {
+        if (SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL))
+            status.priority = THREAD_PRIORITY_TIME_CRITICAL;
+        else
+            LOG(Warning) << "Could not raise thread priority.";
+    }
+    if (config.cpu >= 0 && config.cpu < 64) {
+        if (SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << config.cpu))
+            status.cpu = config.cpu;
+        else
+            LOG(Warning) << "Could not pin thread to CPU " << config.cpu << ".";
+    }
+    if (config.lockMemory)
+        LOG(Warning) << "Memory locking is not supported on this platform.";
+#else
+    LOG(Warning) << "Real-time thread settings are not supported on this platform.";
+#endif
+    prefaultStack(config.prefaultStack);
+    status.prefaulted = prefaultHeap(config.prefaultHeap);
+    return status;
+}
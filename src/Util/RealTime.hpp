@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+
+/// Real-time settings requested for a control thread
+struct RtConfig {
+    bool        enabled       = false;       ///< apply any of the settings below
+    int         priority      = 80;          ///< SCHED_FIFO priority (1-99), 0 leaves the scheduler alone
+    int         cpu           = -1;          ///< CPU to pin the thread to, -1 for no pinning
+    bool        lockMemory    = true;        ///< mlockall current and future pages
+    std::size_t prefaultStack = 256 * 1024;  ///< bytes of stack to touch before the first tick
+    std::size_t prefaultHeap  = 4 << 20;     ///< bytes of heap to touch (and keep) before the first tick
+};
+
+/// Real-time settings that were actually applied (trivially copyable so it can go in a Query)
+struct RtStatus {
+    int  priority     = 0;      ///< applied scheduler priority, 0 if unchanged
+    int  cpu          = -1;     ///< CPU the thread is pinned to, -1 if not pinned
+    bool memoryLocked = false;  ///< memory is locked
+    bool prefaulted   = false;  ///< stack and heap were prefaulted
+};
+
+/// Applies config to the calling thread. Every setting is attempted independently,
+/// so missing privileges (e.g. no CAP_SYS_NICE or RLIMIT_MEMLOCK) only drop that
+/// setting; failures are logged as warnings and the result reports what stuck.
+RtStatus applyRealTime(const RtConfig& config);
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+
+/// Single-writer sequence lock for publishing a small, trivially copyable
+/// snapshot. The writer never waits; readers copy the value and retry if the
+/// writer was mid-update, so a reader can never stall the control thread.
+template <typename T>
+class Seqlock {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "Seqlock values must be trivially copyable");
+
+public:
+    Seqlock() : m_seq(0), m_value(), m_retries(0) { }
+
+    /// Publishes a new value (single writer only)
+    void store(const T& value) {
+        std::uint64_t seq = m_seq.load(std::memory_order_relaxed);
+        m_seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(&m_value, &value, sizeof(T));
+        m_seq.store(seq + 2, std::memory_order_release);
+    }
+
+    /// Returns a consistent copy of the most recently published value
+    T load() const {
+        T value;
+        for (;;) {
+            std::uint64_t seq1 = m_seq.load(std::memory_order_acquire);
+            if ((seq1 & 1) == 0) {
+                std::memcpy(&value, &m_value, sizeof(T));
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (m_seq.load(std::memory_order_relaxed) == seq1)
+                    return value;
+            }
+            m_retries.fetch_add(1, std::memory_order_relaxed);
+            std::this_thread::yield();
+        }
+    }
+
+    /// Number of times a reader raced the writer and had to retry
+    std::uint64_t retries() const { return m_retries.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<std::uint64_t>         m_seq;
+    T                                  m_value;
+    mutable std::atomic<std::uint64_t> m_retries;
+};
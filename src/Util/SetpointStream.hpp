@@ -0,0 +1,155 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+/// Timestamped setpoints from a bursty producer (GUI frames, coroutine yields),
+/// resampled at the control rate. The control thread evaluates the stream a
+/// fixed delay in the past, so there are usually samples on both sides of the
+/// evaluation time and producer jitter is smoothed out instead of reproduced.
+/// Storage is allocated once at construction and nothing here allocates afterwards.
+class SetpointStream {
+public:
+    /// How values between samples are reconstructed
+    enum Interpolation : int {
+        Linear = 0,  ///< straight line between neighbouring samples
+        Cubic  = 1   ///< cubic Hermite with finite difference slopes (continuous velocity)
+    };
+
+    /// A timestamped setpoint
+    struct Sample {
+        double time  = 0;  ///< [s] on the clock evaluate is called with
+        double value = 0;
+    };
+
+    /// Feed statistics over the last window
+    struct Jitter {
+        double interval = 0;  ///< [s] mean time between samples
+        double stdDev   = 0;  ///< [s] standard deviation of the time between samples
+        double max      = 0;  ///< [s] longest time between samples
+        double starved  = 0;  ///< fraction of evaluations past the newest sample (delay too short)
+    };
+
+    /// Constructor
+    SetpointStream(std::size_t capacity = 64, double window = 0.5) :
+        m_samples(capacity),
+        m_head(0),
+        m_count(0),
+        m_mode(Linear),
+        m_delay(0.02),
+        m_window(window),
+        m_nextUpdate(window),
+        m_n(0), m_sum(0), m_sumSq(0), m_max(0),
+        m_evaluations(0), m_starved(0)
+    { }
+
+    /// Seconds on the monotonic clock, for converting producer stamps to the evaluation clock
+    static double clock() {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /// Sets the interpolation and how far behind the newest samples the stream is evaluated [s]
+    void configure(Interpolation mode, double delay) {
+        m_mode  = mode;
+        m_delay = std::max(delay, 0.0);
+    }
+
+    /// Adds a sample, ignoring any that are not newer than the last one
+    void push(const Sample& sample) {
+        if (m_count > 0) {
+            double dt = sample.time - at(m_count - 1).time;
+            if (dt <= 0)
+                return;
+            m_n++;
+            m_sum   += dt;
+            m_sumSq += dt * dt;
+            m_max    = std::max(m_max, dt);
+        }
+        if (m_count == m_samples.size()) {
+            m_head = (m_head + 1) % m_samples.size();
+            m_count--;
+        }
+        m_samples[(m_head + m_count) % m_samples.size()] = sample;
+        m_count++;
+    }
+
+    /// Moves every sample by offset [s], for when the evaluation clock is restarted
+    void rebase(double offset) {
+        for (std::size_t i = 0; i < m_count; ++i)
+            m_samples[(m_head + i) % m_samples.size()].time += offset;
+    }
+
+    /// Drops all samples
+    void clear() {
+        m_head  = 0;
+        m_count = 0;
+    }
+
+    /// True once a sample has been pushed since the last clear
+    bool active() const { return m_count > 0; }
+
+    /// Returns the setpoint delay seconds before now (on the same clock as the sample stamps)
+    double evaluate(double now) {
+        double t = now - m_delay;
+        m_evaluations++;
+        if (m_count == 1 || t <= at(0).time)
+            return at(0).value;
+        const Sample& last = at(m_count - 1);
+        if (t >= last.time) {
+            // hold the newest value rather than extrapolate
+            m_starved++;
+            return last.value;
+        }
+        // the evaluation time is almost always near the newest samples
+        std::size_t i = m_count - 2;
+        while (i > 0 && at(i).time > t)
+            --i;
+        const Sample& a = at(i);
+        const Sample& b = at(i + 1);
+        double h   = b.time - a.time;
+        double tau = (t - a.time) / h;
+        if (m_mode == Linear)
+            return a.value + (b.value - a.value) * tau;
+        // slopes from the neighbouring samples, one sided at the ends
+        double ma = i > 0 ? (b.value - at(i - 1).value) / (b.time - at(i - 1).time) : (b.value - a.value) / h;
+        double mb = i + 2 < m_count ? (at(i + 2).value - a.value) / (at(i + 2).time - a.time) : (b.value - a.value) / h;
+        double tau2 = tau * tau, tau3 = tau2 * tau;
+        return (2 * tau3 - 3 * tau2 + 1) * a.value + (tau3 - 2 * tau2 + tau) * h * ma
+             + (-2 * tau3 + 3 * tau2) * b.value + (tau3 - tau2) * h * mb;
+    }
+
+    /// Publishes feed statistics once per window (t is any monotonic time [s])
+    void update(double t) {
+        if (t < m_nextUpdate)
+            return;
+        m_jitter.interval = m_n > 0 ? m_sum / m_n : 0;
+        m_jitter.stdDev   = m_n > 1 ? std::sqrt(std::max(m_sumSq / m_n - m_jitter.interval * m_jitter.interval, 0.0)) : 0;
+        m_jitter.max      = m_max;
+        m_jitter.starved  = m_evaluations > 0 ? (double)m_starved / m_evaluations : 0;
+        m_n = 0; m_sum = 0; m_sumSq = 0; m_max = 0;
+        m_evaluations = 0; m_starved = 0;
+        m_nextUpdate = t + m_window;
+    }
+
+    /// Feed statistics from the last completed window
+    const Jitter& jitter() const { return m_jitter; }
+
+private:
+    /// Sample i, oldest first
+    const Sample& at(std::size_t i) const { return m_samples[(m_head + i) % m_samples.size()]; }
+
+private:
+    std::vector<Sample> m_samples;  ///< ring of samples, oldest at m_head
+    std::size_t   m_head;
+    std::size_t   m_count;
+    Interpolation m_mode;
+    double        m_delay;          ///< [s] evaluation delay behind now
+    double        m_window;         ///< [s] statistics window
+    double        m_nextUpdate;
+    double        m_n, m_sum, m_sumSq, m_max;  ///< intervals in the current window
+    double        m_evaluations, m_starved;    ///< evaluations in the current window
+    Jitter        m_jitter;
+};
@@ -0,0 +1,39 @@
+#include "Util/SimDaq.hpp"
+
+using namespace mahi::daq;
+using namespace mahi::util;
+
+SimDaq::SimDaq() :
+    m_last(Time::Zero),
+    m_started(false)
+{ }
+
+int SimDaq::addPlant(const Wiring& wiring, const CapstanPlant::Params& params) {
+    m_plants.emplace_back(new Node(wiring, params));
+    const Node* node = m_plants.back().get();
+    // the virtual modules sample these on read_all
+    AI.sources[wiring.force]        = [node](Time) { return node->wiring.forceSign * node->plant.state().force * node->wiring.forceGain; };
+    encoder.sources[wiring.encoder] = [node](Time) { return (int)node->wiring.encoderSign * node->plant.counts(); };
+    return (int)m_plants.size() - 1;
+}
+
+void SimDaq::step(const Time& t) {
+    double dt = m_started ? (t - m_last).as_seconds() : 0.0;
+    m_started = true;
+    m_last    = t;
+    for (auto& node : m_plants) {
+        const Wiring& w = node->wiring;
+        bool enabled = static_cast<int>(DO[w.enable]) != 0;
+        node->plant.step(w.commandSign * AO[w.command], enabled, dt);
+        velocity.countsPerSecond[w.encoder] = w.encoderSign * node->plant.countsPerSecond();
+        velocity.velocities[w.encoder]      = w.encoderSign * node->plant.state().velocity;
+    }
+}
+
+CapstanPlant* SimDaq::plantOnEncoder(int ch) {
+    for (auto& node : m_plants) {
+        if (node->wiring.encoder == ch)
+            return &node->plant;
+    }
+    return nullptr;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <Mahi/Daq.hpp>
+#include <Mahi/Robo/Mechatronics/ForceSensor.hpp>
+#include <Mahi/Util/Timing/Time.hpp>
+#include <array>
+#include <memory>
+#include <vector>
+#include "Util/CapstanPlant.hpp"
+
+/// Headless stand-in for the Q8-USB. Builds on mahi::daq::VirtualDaq, so CM::Io
+/// binds to the same AI/AO/DI/DO/encoder modules it does on hardware, and adds a
+/// Q8-style velocity module. Each attached CapstanPlant reads its AO command and
+/// DO enable and drives its encoder and AI force channel (volts = N * forceGain),
+/// each through the signs of its Wiring.
+/// Call step(t) before read_all each tick; plants integrate in substeps of at
+/// most CapstanPlant::Params::maxStep, so the plant runs at or above the hub rate.
+/// Encoder writes (zeroing) are not modelled; plants start at rest at zero.
+class SimDaq : public mahi::daq::VirtualDaq {
+public:
+    static constexpr int Channels = 8;
+
+    /// Channels a plant is wired to (same numbering as CMHub::createDevice) and the
+    /// directions of the rig's amplifier, encoder and force sensor relative to the
+    /// plant (+1 or -1). The CM sign flips undo these on hardware, so a plant wired
+    /// like a rig closes the loop correctly with that rig's calibration file.
+    struct Wiring {
+        int    enable      = 0;   ///< DO channel, amplifier enabled while high
+        int    fault       = 0;   ///< DI channel, held low (no fault)
+        int    command     = 0;   ///< AO channel, amplifier command [V]
+        int    encoder     = 0;   ///< encoder and velocity channel
+        int    force       = 0;   ///< AI channel carrying the contact force
+        double forceGain   = 1;   ///< [V/N] force sensor output
+        double commandSign = -1;  ///< motor torque per positive command
+        double encoderSign = 1;   ///< encoder counts per positive motor motion
+        double forceSign   = -1;  ///< sensor output per positive contact force
+        /// Normal DOF (calibs/CM/dof_normal.json and the CM::Params defaults)
+        static Wiring normal() { return Wiring(); }
+        /// Tangential DOF (calibs/CM/dof_tangential.json)
+        static Wiring tangential() {
+            Wiring w;
+            w.commandSign = 1;
+            w.encoderSign = -1;
+            w.forceSign   = 1;
+            return w;
+        }
+    };
+
+    /// Q8-style encoder velocity (counts/s through operator[], units/s through velocities)
+    struct Velocity {
+        const double& operator[](int ch) const { return countsPerSecond[ch]; }
+        std::array<double, Channels> countsPerSecond = {};
+        std::array<double, Channels> velocities      = {};
+    };
+
+    /// Constructor
+    SimDaq();
+    /// Attaches a plant to a set of channels and returns its index
+    int addPlant(const Wiring& wiring, const CapstanPlant::Params& params);
+    /// Advances every plant to time t using the last written outputs
+    void step(const mahi::util::Time& t);
+    /// Number of plants
+    std::size_t size() const { return m_plants.size(); }
+    /// Plant i
+    CapstanPlant& plant(std::size_t i) { return m_plants[i]->plant; }
+    /// Plant wired to encoder channel ch, nullptr if none
+    CapstanPlant* plantOnEncoder(int ch);
+
+public:
+    Velocity velocity;
+
+private:
+    struct Node {
+        Node(const Wiring& w, const CapstanPlant::Params& p) : wiring(w), plant(p) { }
+        Wiring       wiring;
+        CapstanPlant plant;
+    };
+    std::vector<std::unique_ptr<Node>> m_plants;  ///< stable addresses for the channel sources
+    mahi::util::Time                   m_last;
+    bool                               m_started;
+};
+
+/// Single-axis force sensor on a SimDaq AI channel (N = volts / gain on every axis),
+/// used in place of the ATI transducer when a CMHub is simulated
+class SimForceSensor : public mahi::robo::ForceSensor {
+public:
+    SimForceSensor(const double* channel, double gain) : m_channel(channel), m_gain(gain), m_bias(0) { }
+    double get_force(mahi::robo::Axis axis) override { return *m_channel / m_gain - m_bias; }
+    std::vector<double> get_forces() override { return {get_force(mahi::robo::AxisX)}; }
+    void zero() override { m_bias = *m_channel / m_gain; }
+private:
+    const double* m_channel;
+    double        m_gain;
+    double        m_bias;
+};
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+/// Bounded, lock-free single-producer/single-consumer queue. Storage is
+/// allocated once at construction; push and pop never allocate or block.
+/// Capacity is rounded up to a power of two.
+template <typename T>
+class SpscQueue {
+public:
+    SpscQueue(std::size_t capacity) :
+        m_mask(roundUp(capacity) - 1),
+        m_items(new T[m_mask + 1]),
+        m_head(0),
+        m_tail(0)
+    { }
+
+    /// Pushes an item, returning false if the queue is full (producer only)
+    bool push(const T& item) {
+        std::size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) > m_mask)
+            return false;
+        m_items[tail & m_mask] = item;
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// Pops an item, returning false if the queue is empty (consumer only)
+    bool pop(T& item) {
+        std::size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire))
+            return false;
+        item = m_items[head & m_mask];
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// Returns true if no items are queued
+    bool empty() const {
+        return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+    }
+
+    /// Maximum number of queued items
+    std::size_t capacity() const { return m_mask + 1; }
+
+private:
+    static std::size_t roundUp(std::size_t n) {
+        std::size_t p = 1;
+        while (p < n)
+            p <<= 1;
+        return p;
+    }
+
+    const std::size_t        m_mask;
+    std::unique_ptr<T[]>     m_items;
+    std::atomic<std::size_t> m_head;  ///< next item to pop (written by consumer)
+    std::atomic<std::size_t> m_tail;  ///< next slot to push (written by producer)
+};
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+/// Single-producer/multi-consumer ring of telemetry records. The producer (the
+/// control thread) never blocks or waits on readers. Every slot carries a
+/// sequence number so readers can detect and skip records that were overwritten
+/// while they were being copied, instead of locking the producer out.
+template <typename T>
+class TelemetryRing {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "TelemetryRing records must be trivially copyable");
+
+public:
+    TelemetryRing(std::size_t capacity) :
+        m_capacity(capacity),
+        m_slots(new Slot[capacity]),
+        m_head(0)
+    { }
+
+    /// Publishes a record, overwriting the oldest one when full (producer only)
+    void push_back(const T& value) {
+        std::uint64_t idx  = m_head.load(std::memory_order_relaxed);
+        Slot&         slot = m_slots[idx % m_capacity];
+        // odd sequence marks the slot as being written
+        slot.seq.store(2 * idx + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(&slot.value, &value, sizeof(T));
+        slot.seq.store(2 * idx + 2, std::memory_order_release);
+        m_head.store(idx + 1, std::memory_order_release);
+    }
+
+    /// Reads the record with absolute index idx. Returns false if it has not been
+    /// published yet or was overwritten before the copy completed.
+    bool read(std::uint64_t idx, T& out) const {
+        const Slot&   slot     = m_slots[idx % m_capacity];
+        std::uint64_t expected = 2 * idx + 2;
+        if (slot.seq.load(std::memory_order_acquire) != expected)
+            return false;
+        std::memcpy(&out, &slot.value, sizeof(T));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return slot.seq.load(std::memory_order_relaxed) == expected;
+    }
+
+    /// Copies records published after cursor into out (oldest first) and advances
+    /// cursor. Records that were lost to the producer lapping the reader are skipped.
+    std::size_t read_since(std::uint64_t& cursor, std::vector<T>& out) const {
+        std::uint64_t head = m_head.load(std::memory_order_acquire);
+        if (head - cursor > m_capacity)
+            cursor = head - m_capacity;
+        std::size_t n = 0;
+        T           value;
+        for (; cursor < head; ++cursor) {
+            if (read(cursor, value)) {
+                out.push_back(value);
+                ++n;
+            }
+        }
+        return n;
+    }
+
+    /// Copies a consistent view of the most recent records into out (oldest first)
+    std::size_t snapshot(std::vector<T>& out) const {
+        out.clear();
+        out.reserve(m_capacity);
+        std::uint64_t cursor = 0;
+        return read_since(cursor, out);
+    }
+
+    /// Total number of records ever published (a cursor to the next record)
+    std::uint64_t head() const { return m_head.load(std::memory_order_acquire); }
+
+    /// Number of records currently held
+    std::size_t size() const {
+        std::uint64_t head = m_head.load(std::memory_order_acquire);
+        return head < m_capacity ? (std::size_t)head : m_capacity;
+    }
+
+    /// Maximum number of records held
+    std::size_t capacity() const { return m_capacity; }
+
+private:
+    struct Slot {
+        std::atomic<std::uint64_t> seq{0};
+        T                          value;
+    };
+
+    const std::size_t          m_capacity;
+    std::unique_ptr<Slot[]>    m_slots;
+    std::atomic<std::uint64_t> m_head;
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+// CM_TIMING is set by the CM_TIMING CMake option (ON by default); without it all
+// CM_TIMING_* instrumentation compiles away
+
+#ifdef CM_TIMING
+#define CM_TIMING_BEGIN(var) const auto var = std::chrono::steady_clock::now();
+#define CM_TIMING_END(var, stats) (stats).add(std::chrono::steady_clock::now() - var);
+#else
+#define CM_TIMING_BEGIN(var)
+#define CM_TIMING_END(var, stats)
+#endif
+
+/// Running min/mean/max of a repeated duration, in microseconds
+struct TimingStats {
+    double        min   = 0;  ///< [us]
+    double        mean  = 0;  ///< [us]
+    double        max   = 0;  ///< [us]
+    std::uint64_t count = 0;
+
+    /// Adds one sample
+    void add(std::chrono::steady_clock::duration d) {
+        add(std::chrono::duration<double, std::micro>(d).count());
+    }
+
+    /// Adds one sample in microseconds
+    void add(double us) {
+        min  = count == 0 ? us : std::min(min, us);
+        max  = count == 0 ? us : std::max(max, us);
+        count++;
+        mean += (us - mean) / (double)count;
+    }
+
+    /// Clears all samples
+    void reset() { *this = TimingStats(); }
+};
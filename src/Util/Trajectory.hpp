@@ -0,0 +1,120 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+/// Setpoint trajectory evaluated once per control tick. Segments are queued in
+/// order and each starts from the value the previous one ended on (or from the
+/// current setpoint when the queue was empty), so a chain of segments plays
+/// back without gaps or steps. Storage is allocated once at construction and
+/// evaluate never allocates, so it is safe to run on the control thread.
+class Trajectory {
+public:
+    /// Segment shape
+    enum Profile : int {
+        Linear           = 0,  ///< constant rate to target over duration
+        MinJerk          = 1,  ///< minimum jerk (zero velocity and acceleration at both ends) to target over duration
+        ConstantVelocity = 2,  ///< to target at speed [units/s]
+        Hold             = 3   ///< hold the starting value for duration (target is ignored)
+    };
+
+    /// A queued segment
+    struct Segment {
+        Profile profile  = Hold;
+        double  target   = 0;
+        double  duration = 0;  ///< [s] Linear, MinJerk and Hold
+        double  speed    = 0;  ///< [units/s] ConstantVelocity
+    };
+
+    /// Constructor
+    Trajectory(std::size_t capacity = 64) :
+        m_segments(capacity),
+        m_head(0),
+        m_count(0),
+        m_started(false),
+        m_chained(false),
+        m_t0(0),
+        m_v0(0),
+        m_duration(0)
+    { }
+
+    /// Queues a segment, returning false if the queue is full
+    bool push(const Segment& segment) {
+        if (m_count == m_segments.size())
+            return false;
+        m_segments[(m_head + m_count) % m_segments.size()] = segment;
+        m_count++;
+        return true;
+    }
+
+    /// Drops every queued segment (including the running one), returning how many were dropped
+    std::size_t clear() {
+        std::size_t dropped = m_count;
+        m_head    = 0;
+        m_count   = 0;
+        m_started = false;
+        m_chained = false;
+        return dropped;
+    }
+
+    /// True while there are segments to play
+    bool active() const { return m_count > 0; }
+
+    /// Number of queued segments (including the running one)
+    std::size_t size() const { return m_count; }
+
+    /// Returns the setpoint at time t [s]. value is the current setpoint, which the
+    /// next segment starts from when nothing was running. completed is set to the
+    /// number of segments that finished on this call.
+    double evaluate(double t, double value, std::size_t& completed) {
+        completed = 0;
+        while (m_count > 0) {
+            const Segment& s = m_segments[m_head];
+            if (!m_started) {
+                // chained segments start where the last one ended in time, not on this tick
+                m_t0       = m_chained ? m_t0 : t;
+                m_v0       = value;
+                m_duration = s.profile == ConstantVelocity ? (s.speed > 0 ? std::abs(s.target - value) / s.speed : 0.0)
+                                                           : std::max(s.duration, 0.0);
+                m_started  = true;
+            }
+            double elapsed = t - m_t0;
+            if (elapsed < m_duration)
+                return shape(s, elapsed / m_duration);
+            value = s.profile == Hold ? m_v0 : s.target;
+            m_t0 += m_duration;
+            m_head = (m_head + 1) % m_segments.size();
+            m_count--;
+            m_started = false;
+            m_chained = true;
+            completed++;
+        }
+        m_chained = false;
+        return value;
+    }
+
+private:
+    /// Value of the running segment at normalized time tau in [0,1)
+    double shape(const Segment& s, double tau) const {
+        switch (s.profile) {
+            case MinJerk:
+                return m_v0 + (s.target - m_v0) * tau * tau * tau * (10.0 - 15.0 * tau + 6.0 * tau * tau);
+            case Hold:
+                return m_v0;
+            default:
+                return m_v0 + (s.target - m_v0) * tau;
+        }
+    }
+
+private:
+    std::vector<Segment> m_segments;  ///< ring of queued segments
+    std::size_t          m_head;      ///< running segment
+    std::size_t          m_count;     ///< queued segments
+    bool                 m_started;   ///< running segment has its start time and value
+    bool                 m_chained;   ///< running segment follows one that ended on its own
+    double               m_t0;        ///< [s] running segment start
+    double               m_v0;        ///< running segment start value
+    double               m_duration;  ///< [s] running segment length
+};
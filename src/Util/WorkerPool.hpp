@@ -0,0 +1,130 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Util/RealTime.hpp"
+
+/// Reusable barrier for a fixed number of threads. Waiters spin for a bounded
+/// time (a tick's worth of work normally arrives inside it), then park on a
+/// condition variable, so idle pinned or SCHED_FIFO workers do not burn a core
+/// between ticks. The last arrival only takes the mutex when someone is parked.
+class SpinBarrier {
+public:
+    SpinBarrier(int parties, std::chrono::nanoseconds spin = std::chrono::microseconds(50)) :
+        m_parties(parties), m_spin(spin), m_waiting(0), m_generation(0), m_sleepers(0) { }
+
+    /// Blocks until all parties have called wait
+    void wait() {
+        unsigned gen = m_generation.load(std::memory_order_acquire);
+        if (m_waiting.fetch_add(1, std::memory_order_acq_rel) + 1 == m_parties) {
+            m_waiting.store(0, std::memory_order_relaxed);
+            m_generation.fetch_add(1, std::memory_order_seq_cst);
+            if (m_sleepers.load(std::memory_order_seq_cst) > 0) {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_wake.notify_all();
+            }
+            return;
+        }
+        const auto deadline = std::chrono::steady_clock::now() + m_spin;
+        for (int spins = 0; m_generation.load(std::memory_order_acquire) == gen; ++spins) {
+            if (std::chrono::steady_clock::now() < deadline) {
+                if (spins > 100)
+                    std::this_thread::yield();
+                continue;
+            }
+            // park; sleepers is raised before generation is rechecked, so the release sees it
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_sleepers.fetch_add(1, std::memory_order_seq_cst);
+            m_wake.wait(lock, [&]() { return m_generation.load(std::memory_order_seq_cst) != gen; });
+            m_sleepers.fetch_sub(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+
+    /// Number of threads that meet at the barrier
+    int parties() const { return m_parties; }
+
+private:
+    const int                      m_parties;
+    const std::chrono::nanoseconds m_spin;        ///< time to spin before parking
+    std::atomic<int>               m_waiting;
+    std::atomic<unsigned>          m_generation;
+    std::atomic<int>               m_sleepers;    ///< parked waiters
+    std::mutex                     m_mutex;
+    std::condition_variable        m_wake;
+};
+
+/// Fork-join pool for the control thread. run() splits a task into one part per
+/// thread (the caller runs part 0), starts the workers with one barrier and
+/// joins them with another, so a tick allocates nothing. Workers park between
+/// ticks once their spin budget runs out, which costs one futex wake per tick.
+class WorkerPool {
+public:
+    /// A task part: called with the user context, the part index and the part count
+    using Task = void (*)(void* ctx, int part, int parts);
+
+    /// Starts workers - 1 threads (the caller is the remaining worker). Each
+    /// thread applies rt with rt.cpu = cpus[i + 1] if cpus has an entry for it.
+    WorkerPool(int workers, const RtConfig& rt = RtConfig(), const std::vector<int>& cpus = {}) :
+        m_parts(workers < 1 ? 1 : workers),
+        m_start(m_parts),
+        m_done(m_parts),
+        m_task(nullptr),
+        m_ctx(nullptr),
+        m_stop(false)
+    {
+        for (int part = 1; part < m_parts; ++part) {
+            RtConfig config = rt;
+            config.cpu = part < (int)cpus.size() ? cpus[part] : -1;
+            m_threads.emplace_back(&WorkerPool::workerFunction, this, part, config);
+        }
+    }
+
+    ~WorkerPool() {
+        m_stop = true;
+        m_start.wait();
+        for (auto& thread : m_threads)
+            thread.join();
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    /// Runs task on every thread and returns once all parts are done
+    void run(Task task, void* ctx) {
+        m_task = task;
+        m_ctx  = ctx;
+        m_start.wait();
+        task(ctx, 0, m_parts);
+        m_done.wait();
+    }
+
+    /// Number of parts a task is split into (workers including the caller)
+    int size() const { return m_parts; }
+
+private:
+    void workerFunction(int part, RtConfig rt) {
+        applyRealTime(rt);
+        for (;;) {
+            m_start.wait();
+            if (m_stop)
+                return;
+            m_task(m_ctx, part, m_parts);
+            m_done.wait();
+        }
+    }
+
+    const int                m_parts;
+    SpinBarrier              m_start;  ///< releases workers into a task
+    SpinBarrier              m_done;   ///< joins workers after a task
+    Task                     m_task;   ///< written before m_start, read after it
+    void*                    m_ctx;
+    std::atomic<bool>        m_stop;
+    std::vector<std::thread> m_threads;
+};